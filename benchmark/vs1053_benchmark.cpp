@@ -0,0 +1,401 @@
+/**
+ * Benchmark which measures the overhead of the driver against the VS1053Simulator.
+ * For each scenario we report the SPI transactions, pin toggles, virtual SPI calls,
+ * bytes on the wire, DREQ stalls and the wall time normalized to one unit of work.
+ * The exit code is 1 if the statically dispatched data path is not cheaper.
+ *
+ * Usage: vs1053_benchmark [--json]
+ */
+#include <chrono>
+#include <string>
+#include <vector>
+#include "VS1053Driver.h"
+#include "VS1053Simulator.h"
+#include "VS1053Static.h"
+#include "VS1053SPIThreaded.h"
+
+using namespace arduino_vs1053;
+
+const uint8_t CS = 5;
+const uint8_t DCS = 16;
+const uint8_t DREQ = 4;
+
+/// Measured values of a single scenario
+struct BenchmarkResult {
+    std::string name;
+    std::string unit;
+    double units = 1.0;
+    double wall_ms = 0;
+    double virtual_ms = 0;
+    double cpu_percent = 0;
+    VS1053SimulatorStats stats;
+};
+
+/// Collects the measurements of the simulator and the wall clock
+class Benchmark {
+  public:
+    Benchmark(VS1053Simulator &sim) : sim(sim) {}
+
+    void start() {
+        sim.resetStats();
+        start_virtual_us = sim.now();
+        start_wall = std::chrono::steady_clock::now();
+    }
+
+    void stop(const char *name, const char *unit, double units) {
+        auto end_wall = std::chrono::steady_clock::now();
+        BenchmarkResult result;
+        result.name = name;
+        result.unit = unit;
+        result.units = units;
+        result.wall_ms = std::chrono::duration<double, std::milli>(end_wall - start_wall).count();
+        result.virtual_ms = (sim.now() - start_virtual_us) / 1000.0;
+        result.cpu_percent = sim.cpuLoad(sim.now() - start_virtual_us);
+        result.stats = sim.stats();
+        results.push_back(result);
+    }
+
+    void printText() {
+        printf("%-16s %-10s %12s %12s %12s %12s %12s %12s %10s %12s %6s %9s\n", "scenario", "per", "transactions",
+               "pin toggles", "pin reads", "spi calls", "bytes", "dreq stalls", "wall ms", "virtual ms", "cpu %",
+               "overflows");
+        for (auto &r : results) {
+            printf("%-16s %-10s %12.0f %12.0f %12.0f %12.0f %12.0f %12.0f %10.3f %12.3f %6.1f %9.0f\n", r.name.c_str(),
+                   r.unit.c_str(), r.stats.transactions / r.units, r.stats.pin_toggles / r.units,
+                   r.stats.pin_reads / r.units, r.stats.spi_calls / r.units, r.stats.spi_bytes / r.units,
+                   r.stats.dreq_stalls / r.units,
+                   r.wall_ms / r.units, r.virtual_ms / r.units, r.cpu_percent, r.stats.fifo_overflows / r.units);
+        }
+    }
+
+    void printJson() {
+        printf("{\n  \"results\": [\n");
+        for (size_t j = 0; j < results.size(); j++) {
+            auto &r = results[j];
+            printf("    {\"name\": \"%s\", \"unit\": \"%s\", \"transactions\": %.1f, \"pin_toggles\": %.1f, "
+                   "\"pin_reads\": %.1f, \"spi_calls\": %.1f, \"spi_bytes\": %.1f, \"dreq_stalls\": %.1f, "
+                   "\"fifo_overflows\": %.1f, \"record_overflows\": %.1f, \"sci_busy_access\": %.1f, \"speed_errors\": %.1f, "
+                   "\"wall_ms\": %.4f, "
+                   "\"virtual_ms\": %.4f, "
+                   "\"cpu_percent\": %.2f}%s\n",
+                   r.name.c_str(), r.unit.c_str(), r.stats.transactions / r.units, r.stats.pin_toggles / r.units,
+                   r.stats.pin_reads / r.units, r.stats.spi_calls / r.units, r.stats.spi_bytes / r.units,
+                   r.stats.dreq_stalls / r.units, r.stats.fifo_overflows / r.units,
+                   r.stats.record_overflows / r.units, r.stats.sci_busy_access / r.units,
+                   r.stats.speed_errors / r.units, r.wall_ms / r.units, r.virtual_ms / r.units,
+                   r.cpu_percent, j + 1 < results.size() ? "," : "");
+        }
+        printf("  ]\n}\n");
+    }
+
+    /// Provides a result: negative indexes count from the end
+    const BenchmarkResult &result(int index) { return results[index < 0 ? results.size() + index : index]; }
+
+  protected:
+    VS1053Simulator &sim;
+    std::vector<BenchmarkResult> results;
+    uint64_t start_virtual_us = 0;
+    std::chrono::steady_clock::time_point start_wall;
+};
+
+/// Feeds 1 MB of MP3 data in 64 byte chunks like the WebRadioDemo
+void benchmarkMp3(Benchmark &bench, VS1053Simulator &sim, VS1053 &player, VS1053DreqWait &wait,
+                  const char *name, size_t chunkSize = 64, bool burst = false) {
+    sim.setBitrate(128000);
+    player.setDreqWait(wait);
+    player.beginOutput();
+    player.setBurstMode(burst);
+    std::vector<uint8_t> data(1024 * 1024, 0x55);
+    bench.start();
+    for (size_t pos = 0; pos < data.size(); pos += chunkSize) {
+        player.writeAudio(data.data() + pos, chunkSize);
+    }
+    bench.stop(name, "MB", 1.0);
+    player.setBurstMode(false);
+}
+
+/// Feeds 1 MB of MP3 data in 4 KB blocks with a pause after each block like a network stream, so that
+/// the FIFO has drained when the next block arrives: burst mode sends the free space in one transfer
+void benchmarkMp3Paused(Benchmark &bench, VS1053Simulator &sim, VS1053 &player, VS1053DreqWait &wait,
+                        const char *name, bool burst) {
+    const size_t block = 4096;
+    sim.setBitrate(128000);
+    player.setDreqWait(wait);
+    player.beginOutput();
+    player.setBurstMode(burst);
+    std::vector<uint8_t> data(1024 * 1024, 0x55);
+    bench.start();
+    for (size_t pos = 0; pos < data.size(); pos += block) {
+        player.writeAudio(data.data() + pos, block);
+        delay(200);
+    }
+    bench.stop(name, "MB", 1.0);
+    player.setBurstMode(false);
+}
+
+/// Feeds 1 MB of MP3 data in 64 byte chunks with the statically dispatched driver
+void benchmarkMp3Static(Benchmark &bench, VS1053Simulator &sim) {
+    VS1053Static<VS1053Simulator, CS, DCS, DREQ> player(sim);
+    sim.setBitrate(128000);
+    player.beginOutput();
+    std::vector<uint8_t> data(1024 * 1024, 0x55);
+    bench.start();
+    for (size_t pos = 0; pos < data.size(); pos += 64) {
+        player.writeAudio(data.data() + pos, 64);
+    }
+    bench.stop("mp3-static", "MB", 1.0);
+}
+
+/**
+ * Transport which forwards the setup to the simulator but drops the audio data when it is
+ * switched to null: DREQ stays high, so only the overhead of the data path is measured.
+ */
+class NullAudioSPI : public VS1053_SPI {
+  public:
+    NullAudioSPI(VS1053_SPI &spi) : spi(spi) {}
+    void setNull(bool flag) { is_null = flag; }
+    using VS1053_SPI::beginTransaction;
+    void beginTransaction() override {
+        if (!is_null) spi.beginTransaction();
+    }
+    void endTransaction() override {
+        if (!is_null) spi.endTransaction();
+    }
+    void set_speed(uint32_t speed) override {
+        if (!is_null) spi.set_speed(speed);
+    }
+    void write(uint8_t data) override { spi.write(data); }
+    void write16(uint16_t data) override { spi.write16(data); }
+    void write_bytes(uint8_t *data, uint32_t size) override {
+        if (!is_null) spi.write_bytes(data, size);
+    }
+    uint8_t transfer(uint8_t data) override { return spi.transfer(data); }
+    uint16_t read16(uint16_t port) override { return spi.read16(port); }
+
+  protected:
+    VS1053_SPI &spi;
+    bool is_null = false;
+};
+
+/// Pin access for the static driver when the chip is not connected: DREQ is always high
+struct NullGpio {
+    template <uint8_t pin>
+    static inline void setup() {}
+
+    template <uint8_t pin>
+    static inline void write(uint8_t) {}
+
+    template <uint8_t pin>
+    static inline bool read() {
+        return true;
+    }
+};
+
+/// Feeds 16 MB in 32 byte chunks to a transport which drops the data: the result only
+/// contains the dispatch and pin access cost of the audio data path
+void benchmarkDispatch(Benchmark &bench, VS1053Simulator &sim, VS1053 &player, NullAudioSPI &spi,
+                       const char *name) {
+    std::vector<uint8_t> data(1024 * 1024, 0x55);
+    player.beginOutput();
+    // the first data loads the pending patches and waits for the chip
+    player.writeAudio(data.data(), 32);
+    spi.setNull(true);
+    bench.start();
+    for (int j = 0; j < 16; j++) {
+        for (size_t pos = 0; pos < data.size(); pos += 32) {
+            player.writeAudio(data.data() + pos, 32);
+        }
+    }
+    bench.stop(name, "MB", 16.0);
+    spi.setNull(false);
+}
+
+/// Feeds 1 MB of a 1 Mbit/s FLAC stream which needs a 4.5 x clock to be decoded in real time
+void benchmarkFlac(Benchmark &bench, VS1053Simulator &sim, VS1053 &player, VS1053DreqWait &wait,
+                   VS1053_CLOCK clock, const char *name) {
+    sim.setBitrate(1000000);
+    sim.setDecoderClock(55296000);
+    player.setDreqWait(wait);
+    player.setClock(clock);
+    player.beginOutput();
+    std::vector<uint8_t> data(1024 * 1024, 0x55);
+    memcpy(data.data(), "fLaC", 4);
+    bench.start();
+    for (size_t pos = 0; pos < data.size(); pos += 512) {
+        player.writeAudio(data.data() + pos, 512);
+    }
+    bench.stop(name, "MB", 1.0);
+    player.setClock(VS1053_CLOCK_30X);
+    sim.setDecoderClock(0);
+}
+
+/// Measures the time until the player is ready for the first audio data
+void benchmarkStartup(Benchmark &bench, VS1053 &player) {
+    bench.start();
+    player.begin();
+    bench.stop("startup", "begin", 1.0);
+    bench.start();
+    player.beginOutput();
+    bench.stop("startup-output", "begin", 1.0);
+    player.setLazyPatches(true);
+    bench.start();
+    player.beginOutput();
+    bench.stop("startup-lazy", "begin", 1.0);
+    player.setLazyPatches(false);
+}
+
+/// Reads the decoded time and sets the volume 1000 times while the FIFO is kept full
+void benchmarkControl(Benchmark &bench, VS1053Simulator &sim, VS1053 &player) {
+    sim.setBitrate(128000);
+    player.beginOutput();
+    uint8_t data[32] = {0};
+    bench.start();
+    for (int j = 0; j < 1000; j++) {
+        while (player.writeAudioNonBlocking(data, sizeof(data)) > 0);
+        player.getDecodedTime();
+        player.setVolume(j % 100);
+    }
+    bench.stop("control", "1000 ops", 1.0);
+}
+
+/// Stops a song: sends the end fill bytes and cancels the decoding
+void benchmarkStopSong(Benchmark &bench, VS1053 &player) {
+    player.beginOutput();
+    player.startSong();
+    bench.start();
+    player.stopSong();
+    bench.stop("stop-song", "stop", 1.0);
+}
+
+/// Records one second of 48 kHz stereo audio
+void benchmarkRecording(Benchmark &bench, VS1053Simulator &sim, VS1053 &player) {
+    VS1053Recording cfg;
+    cfg.setSampleRate(48000);
+    cfg.setChannels(2);
+    player.beginInput(cfg);
+    uint8_t buffer[1024];
+    bench.start();
+    uint64_t end = sim.now() + 1000000;
+    while (sim.now() < end) {
+        if (player.readBytes(buffer, sizeof(buffer)) == 0) {
+            delay(1);
+        }
+    }
+    bench.stop("recording-48k", "s", 1.0);
+}
+
+/// Records one second of 48 kHz stereo audio reading only when the buffer is 75% full
+void benchmarkRecordingScheduled(Benchmark &bench, VS1053Simulator &sim, VS1053 &player) {
+    VS1053Recording cfg;
+    cfg.setSampleRate(48000);
+    cfg.setChannels(2);
+    player.beginInput(cfg);
+    uint8_t buffer[4096];
+    bench.start();
+    uint64_t end = sim.now() + 1000000;
+    while (sim.now() < end) {
+        uint32_t wait_us = player.nextReadDelay();
+        if (wait_us > 0) {
+            delay(wait_us / 1000 + 1);
+        }
+        player.readBytes(buffer, sizeof(buffer));
+    }
+    bench.stop("recording-sched", "s", 1.0);
+}
+
+/// Uploads a compressed plugin
+void benchmarkPatch(Benchmark &bench, VS1053 &player, const char *name, const unsigned short *plugin,
+                    unsigned short size) {
+    player.begin();
+    bench.start();
+    player.loadUserCode(plugin, size);
+    bench.stop(name, "upload", 1.0);
+}
+
+/// Sends 1000 MIDI note on/off messages
+void benchmarkMidi(Benchmark &bench, VS1053 &player) {
+    player.beginMidi();
+    bench.start();
+    for (int j = 0; j < 1000; j++) {
+        player.sendMidiMessage(j % 2 == 0 ? 0x90 : 0x80, 60, 100);
+    }
+    bench.stop("midi", "1000 msgs", 1.0);
+}
+
+/// Sends 1000 MIDI note on/off messages as chords of 4 notes in one batch
+void benchmarkMidiBatch(Benchmark &bench, VS1053 &player) {
+    player.beginMidi();
+    bench.start();
+    for (int j = 0; j < 1000; j += 4) {
+        player.beginMidiBatch();
+        for (int k = 0; k < 4; k++) {
+            player.sendMidiMessage(j % 8 == 0 ? 0x90 : 0x80, 60 + k * 4, 100);
+        }
+        player.endMidiBatch();
+    }
+    bench.stop("midi-batch", "1000 msgs", 1.0);
+}
+
+int main(int argc, char **argv) {
+    bool json = argc > 1 && strcmp(argv[1], "--json") == 0;
+    bool is_failed = false;
+    VS1053Logger.begin(VS1053Console, VS1053Error);
+
+    VS1053Simulator sim(CS, DCS, DREQ);
+    sim.begin();
+    VS1053 player(CS, DCS, DREQ, -1, &sim);
+    Benchmark bench(sim);
+
+    VS1053DreqWaitBusy busy;
+    VS1053DreqWaitInterrupt interrupt;
+    VS1053DreqWaitPredictive predictive;
+    benchmarkStartup(bench, player);
+    benchmarkMp3(bench, sim, player, interrupt, "mp3-interrupt");
+    benchmarkMp3(bench, sim, player, predictive, "mp3-predictive");
+    benchmarkMp3(bench, sim, player, busy, "mp3");
+    benchmarkMp3Static(bench, sim);
+    {
+        // the static driver must avoid the pin hooks and be faster on the same data path
+        NullAudioSPI null_spi(sim);
+        VS1053 dynamic_player(CS, DCS, DREQ, -1, &null_spi);
+        VS1053Static<NullAudioSPI, CS, DCS, DREQ, NullGpio> static_player(null_spi);
+        benchmarkDispatch(bench, sim, dynamic_player, null_spi, "dispatch");
+        benchmarkDispatch(bench, sim, static_player, null_spi, "dispatch-static");
+        const BenchmarkResult &dynamic_result = bench.result(-2);
+        const BenchmarkResult &static_result = bench.result(-1);
+        if (static_result.stats.pin_reads + static_result.stats.pin_toggles > 0 ||
+            static_result.wall_ms >= dynamic_result.wall_ms) {
+            fprintf(stderr, "dispatch-static is not faster than dispatch\n");
+            is_failed = true;
+        }
+    }
+    benchmarkMp3(bench, sim, player, predictive, "mp3-512", 512);
+    benchmarkMp3(bench, sim, player, predictive, "mp3-512-burst", 512, true);
+    benchmarkMp3Paused(bench, sim, player, predictive, "mp3-paused", false);
+    benchmarkMp3Paused(bench, sim, player, predictive, "mp3-paused-burst", true);
+    {
+        // the FIFO model is checked while the last chunk is sent in the background
+        VS1053_SPIThreaded threaded(sim);
+        VS1053 async_player(CS, DCS, DREQ, -1, &threaded);
+        benchmarkMp3Paused(bench, sim, async_player, predictive, "mp3-paused-async", true);
+    }
+    benchmarkFlac(bench, sim, player, predictive, VS1053_CLOCK_30X, "flac-3.0x");
+    benchmarkFlac(bench, sim, player, predictive, VS1053_CLOCK_AUTO, "flac-auto");
+    benchmarkControl(bench, sim, player);
+    benchmarkStopSong(bench, player);
+    benchmarkRecording(bench, sim, player);
+    benchmarkRecordingScheduled(bench, sim, player);
+    benchmarkPatch(bench, player, "patch-generic", PATCHES, PATCHES_SIZE);
+    benchmarkPatch(bench, player, "patch-pcm1053", pcm1053, PLUGIN_SIZE_pcm1053);
+    benchmarkPatch(bench, player, "patch-midi1053", MIDI1053, MIDI1053_SIZE);
+    benchmarkMidi(bench, player);
+    benchmarkMidiBatch(bench, player);
+
+    if (json) {
+        bench.printJson();
+    } else {
+        bench.printText();
+    }
+    sim.end();
+    return is_failed ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+/**
+  Web radio for the ESP32 which uses a VS1053Feeder: the loop only reads the
+  network data into the ring buffer of the feeder and a background task sends
+  it to the VS1053. So a slow network does not block the VS1053 and waiting
+  for DREQ does not block the network.
+
+  Wiring:
+  --------------------------
+  | VS1053  |  ESP32       |
+  --------------------------
+  |   SCK   |   IO18       |
+  |   MISO  |   IO19       |
+  |   MOSI  |   IO23       |
+  |   XRST  |   EN         |
+  |   CS    |   IO5        |
+  |   DCS   |   IO16       |
+  |   DREQ  |   IO4        |
+  |   5V    |   5V         |
+  |   GND   |   GND        |
+  --------------------------
+*/
+
+#include <WiFi.h>
+#include <VS1053Driver.h>
+#include <VS1053Feeder.h>
+
+#define VS1053_CS     5
+#define VS1053_DCS    16
+#define VS1053_DREQ   4
+#define UNDEFINED    -1
+#define VOLUME  80
+
+VS1053 player(VS1053_CS, VS1053_DCS, VS1053_DREQ, UNDEFINED, SPI);
+VS1053DreqWaitInterrupt dreq_wait;
+VS1053Feeder feeder(player);
+WiFiClient client;
+
+// WiFi settings example, substitute your own
+const char *ssid = "TP-Link";
+const char *password = "xxxxxxxx";
+
+//  http://comet.shoutca.st:8563/1
+const char *host = "comet.shoutca.st";
+const char *path = "/1";
+int httpPort = 8563;
+
+uint8_t buffer[1024];
+
+void connect() {
+    if (client.connect(host, httpPort)) {
+        client.print(String("GET ") + path + " HTTP/1.1\r\n" +
+                     "Host: " + host + "\r\n" +
+                     "Connection: close\r\n\r\n");
+    }
+}
+
+void setup() {
+    Serial.begin(115200);
+
+    SPI.begin();
+    player.setDreqWait(dreq_wait);
+    player.beginOutput();
+    player.setVolume(VOLUME);
+    feeder.begin(32 * 1024);
+
+    WiFi.begin(ssid, password);
+    while (WiFi.status() != WL_CONNECTED) {
+        delay(500);
+        Serial.print(".");
+    }
+    Serial.println("WiFi connected");
+    connect();
+}
+
+void loop() {
+    if (!client.connected()) {
+        Serial.println("Reconnecting...");
+        connect();
+    }
+
+    // only read what fits into the feeder buffer
+    size_t len = min((size_t)client.available(), min(sizeof(buffer), feeder.availableForWrite()));
+    if (len > 0) {
+        // read() returns -1 if there is no data
+        int n = client.read(buffer, len);
+        if (n > 0) feeder.write(buffer, n);
+    }
+}
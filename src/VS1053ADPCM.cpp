@@ -0,0 +1,86 @@
+#include "VS1053ADPCM.h"
+
+namespace arduino_vs1053 {
+
+const int16_t VS1053ADPCM::step_table[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,
+    25,    28,    31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,
+    88,    97,    107,   118,   130,   143,   157,   173,   190,   209,   230,   253,   279,
+    307,   337,   371,   408,   449,   494,   544,   598,   658,   724,   796,   876,   963,
+    1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,  2272,  2499,  2749,  3024,  3327,
+    3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+const int8_t VS1053ADPCM::index_table[16] = {-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+
+static uint8_t *write16(uint8_t *out, uint16_t value) {
+    *out++ = value & 0xFF;
+    *out++ = value >> 8;
+    return out;
+}
+
+static uint8_t *write32(uint8_t *out, uint32_t value) {
+    out = write16(out, value & 0xFFFF);
+    return write16(out, value >> 16);
+}
+
+static uint8_t *write_id(uint8_t *out, const char *id) {
+    for (int j = 0; j < 4; j++) *out++ = id[j];
+    return out;
+}
+
+size_t VS1053ADPCM::writeWavHeader(uint8_t *out, uint32_t sampleRate, uint8_t channels, uint32_t dataSize) {
+    uint16_t block_align = block_size * channels;
+    uint32_t blocks = dataSize / block_align;
+    if (dataSize == 0) dataSize = 0xFFFFFFFF - wav_header_size;
+    uint8_t *p = out;
+    p = write_id(p, "RIFF");
+    p = write32(p, dataSize + wav_header_size - 8);
+    p = write_id(p, "WAVE");
+    p = write_id(p, "fmt ");
+    p = write32(p, 20);
+    p = write16(p, 0x11); // IMA ADPCM
+    p = write16(p, channels);
+    p = write32(p, sampleRate);
+    p = write32(p, static_cast<uint64_t>(sampleRate) * block_align / samples_per_block);
+    p = write16(p, block_align);
+    p = write16(p, 4); // bits per sample
+    p = write16(p, 2); // extra size
+    p = write16(p, samples_per_block);
+    p = write_id(p, "fact");
+    p = write32(p, 4);
+    p = write32(p, blocks * samples_per_block);
+    p = write_id(p, "data");
+    p = write32(p, dataSize);
+    return p - out;
+}
+
+size_t VS1053ADPCM::decodeBlock(const uint8_t *block, uint8_t channels, int16_t *out) {
+    int32_t predictor[2];
+    int index[2];
+    if (channels < 1 || channels > 2) return 0;
+    // header per channel: predictor, step index, reserved
+    for (int ch = 0; ch < channels; ch++) {
+        const uint8_t *header = block + ch * 4;
+        predictor[ch] = static_cast<int16_t>(header[0] | (header[1] << 8));
+        index[ch] = header[2] > 88 ? 88 : header[2];
+        out[ch] = predictor[ch];
+    }
+    const uint8_t *data = block + 4 * channels;
+    // the data is interleaved in groups of 4 bytes (8 samples) per channel
+    for (int group = 0; group < (samples_per_block - 1) / 8; group++) {
+        for (int ch = 0; ch < channels; ch++) {
+            int16_t *p_out = out + (1 + group * 8) * channels + ch;
+            for (int j = 0; j < 4; j++) {
+                uint8_t byte = *data++;
+                *p_out = decodeSample(byte & 0x0F, predictor[ch], index[ch]);
+                p_out += channels;
+                *p_out = decodeSample(byte >> 4, predictor[ch], index[ch]);
+                p_out += channels;
+            }
+        }
+    }
+    return samples_per_block * channels;
+}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+namespace arduino_vs1053 {
+
+/**
+ * @brief IMA ADPCM support for the recording: the VS1053 provides blocks of 256 bytes
+ * per channel with 505 samples each. We can generate the corresponding WAV header and
+ * decode the blocks back to 16 bit PCM.
+ * @author pschatzmann
+ */
+class VS1053ADPCM {
+  public:
+    /// Size of the WAV header in bytes
+    static const size_t wav_header_size = 60;
+    /// Samples per channel in a block
+    static const uint16_t samples_per_block = 505;
+    /// Bytes per channel in a block
+    static const uint16_t block_size = 256;
+
+    /// Writes the IMA ADPCM WAV header to out (60 bytes): use 0 as dataSize for streams of unknown length
+    static size_t writeWavHeader(uint8_t *out, uint32_t sampleRate, uint8_t channels, uint32_t dataSize = 0);
+
+    /// Decodes a block (256 bytes per channel) into 505 interleaved samples per channel
+    static size_t decodeBlock(const uint8_t *block, uint8_t channels, int16_t *out);
+
+    /// Decodes a 4 bit value and updates the predictor and step index
+    static inline int16_t decodeSample(uint8_t nibble, int32_t &predictor, int &index) {
+        int step = step_table[index];
+        int diff = step >> 3;
+        if (nibble & 4) diff += step;
+        if (nibble & 2) diff += step >> 1;
+        if (nibble & 1) diff += step >> 2;
+        predictor += (nibble & 8) ? -diff : diff;
+        if (predictor > 32767) predictor = 32767;
+        if (predictor < -32768) predictor = -32768;
+        index += index_table[nibble];
+        if (index < 0) index = 0;
+        if (index > 88) index = 88;
+        return static_cast<int16_t>(predictor);
+    }
+
+    static const int16_t step_table[89];
+    static const int8_t index_table[16];
+};
+
+}
@@ -0,0 +1,126 @@
+#include "VS1053Capture.h"
+#if USE_TASKS
+
+namespace arduino_vs1053 {
+
+bool VS1053Capture::begin(size_t bufferSize) {
+    end();
+    block = new (std::nothrow) uint8_t[block_size];
+    // one entry per stored block: the reads can be shorter than a block, so we reserve twice the number of blocks
+    size_t timestamp_count = 2 * (bufferSize / block_size + 1);
+    if (timestamp_count < 64) timestamp_count = 64;
+    if (block == nullptr || (bufferSize > 0 && (!buffer.begin(bufferSize) || !timestamps.begin(timestamp_count * sizeof(Timestamp))))) {
+        VS1053_LOGE("Not enough memory for capture buffer");
+        end();
+        return false;
+    }
+    write_pos = read_pos = 0;
+    last_time_us = 0;
+    overflow_bytes = 0;
+    timestamp_overflows = 0;
+    is_active = true;
+#ifdef ARDUINO_ARCH_ESP32
+    is_task_running = true;
+    BaseType_t rc = task_core < 0
+                        ? xTaskCreate(task, "vs1053-capture", task_stack_size, this, task_priority, &task_handle)
+                        : xTaskCreatePinnedToCore(task, "vs1053-capture", task_stack_size, this, task_priority,
+                                                  &task_handle, task_core);
+    if (rc != pdPASS) {
+        VS1053_LOGE("Could not start capture task");
+        is_active = false;
+        is_task_running = false;
+        end();
+        return false;
+    }
+#else
+    thread = std::thread(task, this);
+#endif
+    return true;
+}
+
+void VS1053Capture::end() {
+    if (is_active) {
+        is_active = false;
+#ifdef ARDUINO_ARCH_ESP32
+        while (is_task_running) delay(1);
+#else
+        if (thread.joinable()) thread.join();
+#endif
+    }
+    buffer.end();
+    timestamps.end();
+    delete[] block;
+    block = nullptr;
+}
+
+size_t VS1053Capture::read(uint8_t *data, size_t len, uint32_t timeoutMs) {
+    size_t result = buffer.read(data, len);
+    uint32_t start = millis();
+    while (result < len && is_active && millis() - start < timeoutMs) {
+        delay(1);
+        result += buffer.read(data + result, len - result);
+    }
+    read_pos += result;
+    return result;
+}
+
+uint32_t VS1053Capture::timestamp() {
+    // drop the entries of the blocks which have been read completely
+    const uint8_t *ptr;
+    while (timestamps.peek(&ptr) >= sizeof(Timestamp)) {
+        Timestamp entry;
+        memcpy(&entry, ptr, sizeof(entry));
+        last_time_us = entry.time_us;
+        if (static_cast<int32_t>(entry.end_pos - read_pos) > 0) break;
+        timestamps.consume(sizeof(Timestamp));
+    }
+    return last_time_us;
+}
+
+void VS1053Capture::task(void *arg) {
+    VS1053Capture *self = static_cast<VS1053Capture *>(arg);
+    self->capture();
+#ifdef ARDUINO_ARCH_ESP32
+    self->is_task_running = false;
+    vTaskDelete(nullptr);
+#endif
+}
+
+/// Producer: reads the recorded data when the recording buffer reaches the fill target
+void VS1053Capture::capture() {
+    while (is_active) {
+        uint32_t wait_us = vs.nextReadDelay();
+        if (wait_us > 0) {
+            // we wake up at least every 10 ms so that end() does not need to wait long
+            delay(wait_us < 10000 ? wait_us / 1000 + 1 : 10);
+            continue;
+        }
+        size_t len = vs.readBytes(block, block_size);
+        if (len == 0) {
+            delay(1);
+            continue;
+        }
+        uint32_t now = micros();
+        if (callback != nullptr) callback(block, len, now, callback_ref);
+        if (buffer.size() > 0) store(block, len, now);
+    }
+}
+
+void VS1053Capture::store(const uint8_t *data, size_t len, uint32_t time_us) {
+    size_t n = len < buffer.availableForWrite() ? len : buffer.availableForWrite();
+    if (n < len) overflow_bytes += len - n;
+    if (n == 0) return;
+    // the timestamp must be visible before the data
+    write_pos += n;
+    if (timestamps.availableForWrite() >= sizeof(Timestamp)) {
+        Timestamp entry{write_pos, time_us};
+        timestamps.write(reinterpret_cast<const uint8_t *>(&entry), sizeof(entry));
+    } else {
+        timestamp_overflows++;
+    }
+    buffer.write(data, n);
+}
+
+}
+
+#endif
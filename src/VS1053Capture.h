@@ -0,0 +1,101 @@
+#pragma once
+#include "VS1053Config.h"
+#if USE_TASKS
+#include "VS1053Driver.h"
+#include "VS1053RingBuffer.h"
+#ifndef ARDUINO
+#include <thread>
+#endif
+
+namespace arduino_vs1053 {
+
+/// Callback which receives each captured block in the capture task
+typedef void (*VS1053CaptureCallback)(const uint8_t *data, size_t len, uint32_t timestamp_us, void *ref);
+
+/**
+ * @brief Background capture: a background task (FreeRTOS task on the ESP32, std::thread
+ * outside of Arduino) reads the recorded data from the VS1053 when the recording buffer
+ * gets full and stores it with the capture time in a lock-free ring buffer. So the
+ * application does not lose any audio if it is busy. Call beginInput() on the VS1053
+ * before begin() and do not use the VS1053 while the capture is active.
+ * @author pschatzmann
+ */
+class VS1053Capture {
+  public:
+    VS1053Capture(VS1053 &vs1053) : vs(vs1053) {}
+    ~VS1053Capture() { end(); }
+
+    /// Allocates the ring buffer (0 if you only use the callback) and starts the background task
+    bool begin(size_t bufferSize = 16 * 1024);
+
+    /// Stops the background task and releases the buffers
+    void end();
+
+    /// Defines a callback which is called by the capture task for each block: call before begin()
+    void setCallback(VS1053CaptureCallback cb, void *ref = nullptr) {
+        callback = cb;
+        callback_ref = ref;
+    }
+
+    /// Reads the captured data: waits up to timeoutMs for len bytes (0 = non-blocking)
+    size_t read(uint8_t *data, size_t len, uint32_t timeoutMs = 0);
+
+    /// Number of bytes which can be read without blocking
+    size_t available() { return buffer.available(); }
+
+    /// Time in us (micros()) at which the block with the next unread byte was captured
+    uint32_t timestamp();
+
+    /// Number of bytes which were lost because the ring buffer was full
+    uint32_t overflows() { return overflow_bytes; }
+
+    /// Number of blocks without timestamp because the timestamp buffer was full: timestamp() reports the next one
+    uint32_t timestampOverflows() { return timestamp_overflows; }
+
+#ifdef ARDUINO_ARCH_ESP32
+    /// Defines the FreeRTOS task priority, stack size and core (-1 for any core): call before begin()
+    void setTaskConfig(UBaseType_t priority, uint32_t stackSize = 4096, int core = -1) {
+        task_priority = priority;
+        task_stack_size = stackSize;
+        task_core = core;
+    }
+#endif
+
+  protected:
+    /// Capture time of the data up to the indicated byte position
+    struct Timestamp {
+        uint32_t end_pos;
+        uint32_t time_us;
+    };
+
+    VS1053 &vs;
+    VS1053RingBuffer buffer;
+    VS1053RingBuffer timestamps; // Timestamp entries which never wrap
+    uint8_t *block = nullptr;
+    const size_t block_size = 4096;
+    uint32_t write_pos = 0; // only used by the capture task
+    uint32_t read_pos = 0;  // only used by the reader
+    uint32_t last_time_us = 0;
+    VS1053CaptureCallback callback = nullptr;
+    void *callback_ref = nullptr;
+    std::atomic<bool> is_active{false};
+    std::atomic<uint32_t> overflow_bytes{0};
+    std::atomic<uint32_t> timestamp_overflows{0};
+#ifdef ARDUINO_ARCH_ESP32
+    TaskHandle_t task_handle = nullptr;
+    std::atomic<bool> is_task_running{false};
+    UBaseType_t task_priority = 2;
+    uint32_t task_stack_size = 4096;
+    int task_core = -1;
+#else
+    std::thread thread;
+#endif
+
+    void capture();
+    void store(const uint8_t *data, size_t len, uint32_t time_us);
+    static void task(void *arg);
+};
+
+}
+
+#endif
@@ -5,7 +5,11 @@ namespace arduino_vs1053{}
 
 // Define Logging Port
 #ifndef VS1053_LOG_PORT
-#  define VS1053_LOG_PORT Serial
+#  ifdef ARDUINO
+#    define VS1053_LOG_PORT Serial
+#  else
+#    define VS1053_LOG_PORT VS1053Console
+#  endif
 #endif
 
 // Define the size of the log buffer
@@ -13,6 +17,21 @@ namespace arduino_vs1053{}
 #  define LOG_BUFFER_SIZE 100
 #endif
 
+// Log messages below this level are removed at compile time: 0=Debug, 1=Info, 2=Warning, 3=Error, 4=None
+#ifndef VS1053_LOG_MIN_LEVEL
+#  define VS1053_LOG_MIN_LEVEL 0
+#endif
+
+// Number of messages which can be queued in the deferred logging mode (power of 2)
+#ifndef VS1053_LOG_QUEUE_SIZE
+#  define VS1053_LOG_QUEUE_SIZE 32
+#endif
+
+// Bytes per queued message for the copies of the %s arguments in the deferred logging mode
+#ifndef VS1053_LOG_TEXT_SIZE
+#  define VS1053_LOG_TEXT_SIZE 32
+#endif
+
 // Enable support for MIDI: set to 0 to minimize memory usage
 #ifndef USE_MIDI
 #  define USE_MIDI 1
@@ -23,11 +42,29 @@ namespace arduino_vs1053{}
 #  define USE_PATCHES 1
 #endif
 
+// Include the FLAC, LATM and pitch patches (about 57 KB of flash): by default only on the ESP32 and outside of Arduino
+#ifndef USE_PATCHES_EXTENDED
+#  if USE_PATCHES && (defined(ARDUINO_ARCH_ESP32) || !defined(ARDUINO))
+#    define USE_PATCHES_EXTENDED 1
+#  else
+#    define USE_PATCHES_EXTENDED 0
+#  endif
+#endif
+
 // Enable support for Input (Recording): set to 0 to minimize memory usage
 #ifndef USE_INPUT
 #  define USE_INPUT 1
 #endif
 
+// Enable support for background tasks (VS1053Feeder): FreeRTOS on the ESP32, std::thread outside of Arduino
+#ifndef USE_TASKS
+#  if defined(ARDUINO_ARCH_ESP32) || !defined(ARDUINO)
+#    define USE_TASKS 1
+#  else
+#    define USE_TASKS 0
+#  endif
+#endif
+
 // I2S Configuration: Use custom SPI Class for ESP
 #ifndef USE_ESP_SPI_CUSTOM
 #  define USE_ESP_SPI_CUSTOM 0
@@ -0,0 +1,210 @@
+#pragma once
+
+#if defined(ARDUINO)
+# include "Arduino.h"
+#else
+# include "VS1053Ext.h"
+#endif
+
+#if defined(ARDUINO_ARCH_ESP32)
+# include "freertos/FreeRTOS.h"
+# include "freertos/semphr.h"
+#endif
+
+/** @file */
+
+namespace arduino_vs1053 {
+
+/**
+ * @brief Abstract strategy which defines how we wait until the VS1053 raises DREQ.
+ * An instance can be assigned to a VS1053 with setDreqWait().
+ * @author pschatzmann
+ */
+class VS1053DreqWait {
+  public:
+    virtual ~VS1053DreqWait() = default;
+
+    /// Called by VS1053::begin()
+    virtual void begin(uint8_t pin) { dreq_pin = pin; }
+
+    /// Waits until DREQ is high: returns false if the timeout (in ms) has passed. 0 waits forever.
+    virtual bool await(uint32_t timeout_ms) = 0;
+
+    /// Information about the number of bytes which have been sent via SDI
+    virtual void onData(size_t /*bytes*/) {}
+
+    /// Returns true if DREQ was low in the last await(): so it has just returned after the rising edge
+    bool waited() { return is_waited; }
+
+  protected:
+    uint8_t dreq_pin = 0;
+    bool is_waited = false;
+
+    bool is_timeout(uint32_t start, uint32_t timeout_ms) {
+        return timeout_ms > 0 && millis() - start >= timeout_ms;
+    }
+};
+
+/**
+ * @brief Default strategy: we poll DREQ and call yield() in between
+ */
+class VS1053DreqWaitBusy : public VS1053DreqWait {
+  public:
+    bool await(uint32_t timeout_ms) override {
+        uint32_t start = timeout_ms > 0 ? millis() : 0;
+        is_waited = false;
+        while (!digitalRead(dreq_pin)) {
+            is_waited = true;
+            if (is_timeout(start, timeout_ms)) return false;
+            yield(); // Very short delay
+        }
+        return true;
+    }
+};
+
+#if defined(ARDUINO_ARCH_ESP32) || !defined(ARDUINO)
+
+/**
+ * @brief We sleep until the rising edge of DREQ triggers an interrupt. On the ESP32
+ * we use a FreeRTOS semaphore, outside of Arduino we use the interrupt support
+ * of the pin hooks.
+ */
+class VS1053DreqWaitInterrupt : public VS1053DreqWait {
+  public:
+    ~VS1053DreqWaitInterrupt() { end(); }
+
+    void begin(uint8_t pin) override {
+        end();
+        dreq_pin = pin;
+#if defined(ARDUINO_ARCH_ESP32)
+        semaphore = xSemaphoreCreateBinary();
+        attachInterruptArg(digitalPinToInterrupt(pin), isr, this, RISING);
+#else
+        pinHooks().attachInterrupt(pin, isr, this);
+#endif
+        is_active = true;
+    }
+
+    void end() {
+        if (!is_active) return;
+#if defined(ARDUINO_ARCH_ESP32)
+        detachInterrupt(digitalPinToInterrupt(dreq_pin));
+        vSemaphoreDelete(semaphore);
+        semaphore = nullptr;
+#else
+        pinHooks().detachInterrupt(dreq_pin);
+#endif
+        is_active = false;
+    }
+
+    bool await(uint32_t timeout_ms) override {
+        uint32_t start = timeout_ms > 0 ? millis() : 0;
+        is_waited = false;
+        while (!digitalRead(dreq_pin)) {
+            is_waited = true;
+            if (is_timeout(start, timeout_ms)) return false;
+            // an edge which happend after the digitalRead is not lost: the wait returns immediatly
+            wait_for_edge(timeout_ms > 0 ? timeout_ms : max_wait_ms);
+        }
+        return true;
+    }
+
+  protected:
+    bool is_active = false;
+    const uint32_t max_wait_ms = 100;
+#if defined(ARDUINO_ARCH_ESP32)
+    SemaphoreHandle_t semaphore = nullptr;
+
+    static void IRAM_ATTR isr(void *arg) {
+        BaseType_t woken = pdFALSE;
+        xSemaphoreGiveFromISR(static_cast<VS1053DreqWaitInterrupt *>(arg)->semaphore, &woken);
+        if (woken) portYIELD_FROM_ISR();
+    }
+
+    void wait_for_edge(uint32_t ms) {
+        xSemaphoreTake(semaphore, pdMS_TO_TICKS(ms));
+    }
+#else
+    static void isr(void * /*arg*/) {}
+
+    void wait_for_edge(uint32_t ms) {
+        pinHooks().waitForInterrupt(ms * 1000);
+    }
+#endif
+};
+
+#endif
+
+/**
+ * @brief We estimate the time which the decoder needs to consume the refill bytes
+ * from the bitrate and sleep with delay() before we poll DREQ again. The bitrate is
+ * measured from the data which is sent while the FIFO is full: the initial value
+ * is used until the first measurement is available.
+ */
+class VS1053DreqWaitPredictive : public VS1053DreqWait {
+  public:
+    VS1053DreqWaitPredictive(uint32_t bitrate = 128000, uint16_t refillBytes = 512) {
+        setBitrate(bitrate);
+        refill_bytes = refillBytes;
+    }
+
+    /// Defines the initial bitrate in bits per second
+    void setBitrate(uint32_t bps) { bitrate_bps = bps > 0 ? bps : 1; }
+
+    /// Provides the actual (estimated) bitrate in bits per second
+    uint32_t bitrate() { return bitrate_bps; }
+
+    /// Defines the number of bytes which we let the decoder consume before we wake up
+    void setRefillBytes(uint16_t bytes) { refill_bytes = bytes; }
+
+    /// Upper limit for a single sleep in ms
+    void setMaxSleep(uint32_t ms) { max_sleep_ms = ms; }
+
+    void onData(size_t bytes) override { total_bytes += bytes; }
+
+    bool await(uint32_t timeout_ms) override {
+        is_waited = false;
+        if (digitalRead(dreq_pin)) return true;
+        is_waited = true;
+        uint32_t start = millis();
+        measure();
+        uint32_t sleep_ms = 8000ul * refill_bytes / bitrate_bps;
+        if (sleep_ms > max_sleep_ms) sleep_ms = max_sleep_ms;
+        if (timeout_ms > 0 && sleep_ms > timeout_ms) sleep_ms = timeout_ms;
+        if (sleep_ms > 0) delay(sleep_ms);
+        // the estimate was too optimistic: poll the rest
+        while (!digitalRead(dreq_pin)) {
+            if (is_timeout(start, timeout_ms)) return false;
+            yield();
+        }
+        return true;
+    }
+
+  protected:
+    uint32_t bitrate_bps;
+    uint16_t refill_bytes;
+    uint32_t max_sleep_ms = 20;
+    uint32_t total_bytes = 0;
+    uint32_t ref_bytes = 0;
+    uint32_t ref_time_us = 0;
+    bool has_ref = false;
+    const uint32_t measure_period_us = 1000000;
+
+    /// DREQ is low, so the FIFO is full: the data sent since the last stall was consumed by the decoder
+    void measure() {
+        uint32_t now = micros();
+        if (!has_ref) {
+            has_ref = true;
+        } else if (now - ref_time_us >= measure_period_us) {
+            uint64_t bits = 8ull * (total_bytes - ref_bytes);
+            uint32_t rate = bits * 1000000ull / (now - ref_time_us);
+            if (rate > 0) bitrate_bps = rate;
+        } else {
+            return;
+        }
+        ref_time_us = now;
+        ref_bytes = total_bytes;
+    }
+};
+
+}
@@ -1,10 +1,12 @@
 #include "VS1053Driver.h"
+#include "VS1053PluginLoader.h"
 
 namespace arduino_vs1053 {
 
 
 VS1053::VS1053(uint8_t _cs_pin, uint8_t _dcs_pin, uint8_t _dreq_pin, uint8_t _reset_pin, VS1053_SPI *_p_spi)
         : cs_pin(_cs_pin), dcs_pin(_dcs_pin), dreq_pin(_dreq_pin), reset_pin(_reset_pin), p_spi(_p_spi) {
+    setup_completion();
 
     if (p_spi==nullptr){
 // if spi parameter is undifined, we use the system specific default drivers
@@ -23,6 +25,7 @@ VS1053::VS1053(uint8_t _cs_pin, uint8_t _dcs_pin, uint8_t _dreq_pin, uint8_t _re
 
 VS1053::VS1053(uint8_t _cs_pin, uint8_t _dcs_pin, uint8_t _dreq_pin, uint8_t _reset_pin, SPIClass &spi)
         : cs_pin(_cs_pin), dcs_pin(_dcs_pin), dreq_pin(_dreq_pin), reset_pin(_reset_pin) {
+    setup_completion();
     static VS1053_SPIArduino vs_spi(spi);
     p_spi = &vs_spi;
 }
@@ -31,26 +34,102 @@ VS1053::VS1053(uint8_t _cs_pin, uint8_t _dcs_pin, uint8_t _dreq_pin, uint8_t _re
 
 
 uint16_t VS1053::readRegister(uint8_t _reg) const {
+    VS1053LockGuard guard(mutex);
+    VS1053SciSession session(*this);
+    return session.read(_reg);
+}
+
+void VS1053::writeRegister(uint8_t _reg, uint16_t _value) const {
+    VS1053LockGuard guard(mutex);
+    VS1053SciSession session(*this, true);
+    session.write(_reg, _value);
+}
+
+uint16_t VS1053::sci_read(uint8_t _reg) const {
     uint16_t result;
 
-    control_mode_on();
+    await_sci_completion();
+    digitalWrite(cs_pin, LOW);
     p_spi->write(3);    // Read operation
     p_spi->write(_reg); // Register to write (0..0xF)
     // Note: transfer16 does not seem to work
     result = (p_spi->transfer(0xFF) << 8) | // Read 16 bits data
              (p_spi->transfer(0xFF));
-    await_data_request(); // Wait for DREQ to be HIGH again
-    control_mode_off();
+    complete_sci(sci_read_completion[_reg & 0xF]);
+    digitalWrite(cs_pin, HIGH);
     return result;
 }
 
-void VS1053::writeRegister(uint8_t _reg, uint16_t _value) const {
-    control_mode_on();
+void VS1053::sci_read_multiple(uint8_t _reg, uint16_t *data, size_t n) const {
+    await_sci_completion();
+    for (size_t j = 0; j < n; j++) {
+        digitalWrite(cs_pin, LOW);
+        p_spi->write(3);    // Read operation
+        p_spi->write(_reg); // Register to read (0..0xF)
+        data[j] = (p_spi->transfer(0xFF) << 8) | p_spi->transfer(0xFF);
+        digitalWrite(cs_pin, HIGH);
+    }
+    complete_sci(sci_read_completion[_reg & 0xF]);
+}
+
+void VS1053::sci_write(uint8_t _reg, uint16_t _value) const {
+    await_sci_completion();
+    digitalWrite(cs_pin, LOW);
     p_spi->write(2);        // Write operation
     p_spi->write(_reg);     // Register to write (0..0xF)
     p_spi->write16(_value); // Send 16 bits data
-    await_data_request();
-    control_mode_off();
+    complete_sci(sci_write_completion[_reg & 0xF]);
+    digitalWrite(cs_pin, HIGH);
+    if (_reg == SCI_CLOCKF) {
+        update_clock(_value);
+        // the SPI clock depends on CLKI: restart the session with the new read speed
+        p_spi->endTransaction();
+        p_spi->beginTransaction(active_speed.sci_read);
+    }
+}
+
+void VS1053::sci_write_multiple(uint8_t _reg, const uint16_t *data, size_t n, bool repeat) const {
+    if (n == 0) return;
+    await_sci_completion();
+    digitalWrite(cs_pin, LOW);
+    p_spi->write(2);        // Write operation
+    p_spi->write(_reg);     // Register to write (0..0xF)
+    for (size_t j = 0; j < n; j++) {
+        // DREQ goes low after each word
+        if (j > 0) await_data_request();
+        p_spi->write16(repeat ? data[0] : data[j]);
+    }
+    complete_sci(sci_write_completion[_reg & 0xF]);
+    digitalWrite(cs_pin, HIGH);
+}
+
+void VS1053::setup_completion() {
+    for (int j = 0; j < 16; j++) {
+        sci_read_completion[j] = VS1053_COMPLETION_NONE;
+        sci_write_completion[j] = VS1053_COMPLETION_DEFERRED;
+    }
+    // WRAM reads are incrementing the address
+    sci_read_completion[SCI_WRAM] = VS1053_COMPLETION_DEFERRED;
+    // changes of the mode, clock and sample rate take longer
+    sci_write_completion[SCI_MODE] = VS1053_COMPLETION_AFTER;
+    sci_write_completion[SCI_CLOCKF] = VS1053_COMPLETION_AFTER;
+    sci_write_completion[SCI_AUDATA] = VS1053_COMPLETION_AFTER;
+}
+
+void VS1053::setWriteCompletion(uint8_t reg, VS1053_COMPLETION policy) {
+    sci_write_completion[reg & 0xF] = policy;
+}
+
+void VS1053::setReadCompletion(uint8_t reg, VS1053_COMPLETION policy) {
+    sci_read_completion[reg & 0xF] = policy;
+}
+
+void VS1053::setDreqWait(VS1053DreqWait &wait) {
+    p_dreq_wait = &wait;
+}
+
+void VS1053::setDreqTimeout(uint32_t ms) {
+    dreq_timeout_ms = ms;
 }
 
 void VS1053::set_flag(uint16_t &reg_value, uint16_t flag, bool active){
@@ -63,62 +142,181 @@ void VS1053::set_flag(uint16_t &reg_value, uint16_t flag, bool active){
 
 void VS1053::sdi_send_buffer(uint8_t *data, size_t len) {
     size_t chunk_length; // Length of chunk 32 byte or shorter
+    bool is_async = p_spi->isAsync();
 
     data_mode_on();
+    size_t max_length = sdi_burst_size(); // Wait for space available
     while (len) // More to do?
     {
-        await_data_request(); // Wait for space available
         chunk_length = len;
-        if (len > vs1053_chunk_size) {
-            chunk_length = vs1053_chunk_size;
+        if (len > max_length) {
+            chunk_length = max_length;
         }
         len -= chunk_length;
-        p_spi->write_bytes(data, chunk_length);
+        if (is_async) {
+            p_spi->write_bytes_async(data, chunk_length);
+        } else {
+            p_spi->write_bytes(data, chunk_length);
+        }
+        p_dreq_wait->onData(chunk_length);
+        fifo_sent(chunk_length);
         data += chunk_length;
+        if (len > 0) max_length = is_async ? sdi_next_size() : sdi_burst_size();
     }
+    if (is_async) p_spi->await_write();
     data_mode_off();
 }
 
-void VS1053::sdi_send_fillers(size_t len) {
-    size_t chunk_length; // Length of chunk 32 byte or shorter
+/// Sends the data which is generated by fill(buffer, pos, len): the next chunk is prepared while the last one is sent
+template <class F>
+void VS1053::sdi_send_double_buffered(size_t len, F fill) {
+    uint8_t buffers[2][vs1053_chunk_size];
+    int active = 0;
+    size_t pos = 0;
+    size_t n = len < vs1053_chunk_size ? len : vs1053_chunk_size;
+    fill(buffers[active], pos, n);
 
+    data_mode_on();
+    sdi_burst_size(); // Wait for space available
+    while (n > 0) {
+        p_spi->write_bytes_async(buffers[active], n);
+        p_dreq_wait->onData(n);
+        fifo_sent(n);
+        pos += n;
+        // the other buffer is free since the last await_write()
+        active = 1 - active;
+        n = len - pos < vs1053_chunk_size ? len - pos : vs1053_chunk_size;
+        if (n > 0) {
+            fill(buffers[active], pos, n);
+            sdi_next_size();
+        }
+    }
+    p_spi->await_write();
+    data_mode_off();
+}
+
+/// Async transfer: the FIFO model is checked while the last chunk is still clocked out, so we only need to
+/// wait for DREQ after the transfer if the model can not guarantee the space for the next chunk
+size_t VS1053::sdi_next_size() {
+    size_t result = fifo_model.free(micros());
+    if (!is_burst_mode && result > vs1053_chunk_size) result = vs1053_chunk_size;
+    p_spi->await_write();
+    // DREQ is only valid after the last chunk has been sent
+    if (result < vs1053_chunk_size) return sdi_burst_size();
+    if (result > vs1053_chunk_size && !digitalRead(dreq_pin)) {
+        // the estimate was too optimistic
+        fifo_model.full(micros());
+        return sdi_burst_size();
+    }
+    return result;
+}
+
+/// Waits for DREQ and returns the max number of bytes which can be sent: in burst mode we use the estimated free FIFO space
+size_t VS1053::sdi_burst_size() {
+    if (!is_burst_mode) {
+        await_data_request(true);
+        return vs1053_chunk_size;
+    }
+    size_t result = fifo_model.free(micros());
+    if (result > vs1053_chunk_size) {
+        // one DREQ check per burst: low tells us that the estimate was too optimistic
+        if (digitalRead(dreq_pin)) return result;
+        fifo_model.full(micros());
+    }
+    // the rising edge of DREQ calibrates the model
+    await_data_request(true);
+    if (p_dreq_wait->waited()) {
+        fifo_model.rising(micros());
+    } else {
+        fifo_model.ready(micros());
+    }
+    result = fifo_model.free(micros());
+    // DREQ high guarantees space for 32 bytes
+    return result > vs1053_chunk_size ? result : vs1053_chunk_size;
+}
+
+void VS1053::fifo_sent(size_t len) {
+    // the async transfers use the model to check the space for the next chunk
+    if (is_burst_mode || p_spi->isAsync()) fifo_model.sent(len, micros());
+}
+
+void VS1053::setBurstMode(bool active) {
+    VS1053LockGuard guard(mutex);
+    is_burst_mode = active;
+    fifo_model.clear();
+}
+
+void VS1053::sdi_send_fillers(size_t len) {
+    if (p_spi->isAsync()) {
+        uint8_t fill_byte = endFillByte;
+        sdi_send_double_buffered(len, [fill_byte](uint8_t *buffer, size_t, size_t n) {
+            memset(buffer, fill_byte, n);
+        });
+        return;
+    }
     data_mode_on();
     while (len) // More to do?
     {
-        await_data_request(); // Wait for space available
-        chunk_length = len;
-        if (len > vs1053_chunk_size) {
-            chunk_length = vs1053_chunk_size;
+        size_t chunk_length = sdi_burst_size(); // Wait for space available
+        if (chunk_length > len) {
+            chunk_length = len;
         }
         len -= chunk_length;
-        while (chunk_length--) {
-            p_spi->write(endFillByte);
+        p_spi->write_repeat(endFillByte, chunk_length);
+        p_dreq_wait->onData(chunk_length);
+        fifo_sent(chunk_length);
+    }
+    data_mode_off();
+}
+
+/// Sends MIDI data: each byte is sent as 16 bit word (0x00, byte)
+void VS1053::sdi_send_midi(const uint8_t *data, size_t len) {
+    if (p_spi->isAsync()) {
+        sdi_send_double_buffered(len * 2, [data](uint8_t *buffer, size_t pos, size_t n) {
+            for (size_t j = 0; j < n; j++) {
+                buffer[j] = (pos + j) % 2 == 0 ? 0x00 : data[(pos + j) / 2];
+            }
+        });
+        return;
+    }
+    data_mode_on();
+    while (len) {
+        size_t n = sdi_burst_size() / 2; // Wait for space available
+        if (n > len) {
+            n = len;
         }
+        p_spi->write_interleaved(0x00, data, n);
+        p_dreq_wait->onData(n * 2);
+        fifo_sent(n * 2);
+        data += n;
+        len -= n;
     }
     data_mode_off();
 }
 
 void VS1053::wram_write(uint16_t address, uint16_t data) {
-    writeRegister(SCI_WRAMADDR, address);
-    writeRegister(SCI_WRAM, data);
+    VS1053LockGuard guard(mutex);
+    VS1053SciSession session(*this);
+    session.wramWrite(address, data);
 }
 
 uint16_t VS1053::wram_read(uint16_t address) {
-    writeRegister(SCI_WRAMADDR, address); // Start reading from WRAM
-    return readRegister(SCI_WRAM);        // Read back result
+    VS1053LockGuard guard(mutex);
+    VS1053SciSession session(*this);
+    return session.wramRead(address);
 }
 
 bool VS1053::testComm(const char *header) {
+    VS1053LockGuard guard(mutex);
     // Test the communication with the VS1053 module.  The result will be returned.
     // If DREQ is low, there is problably no VS1053 connected.  Pull the line HIGH
     // in order to prevent an endless loop waiting for this signal.  The rest of the
     // software will still work, but readbacks from VS1053 will fail.
     int i; // Loop control
-    uint16_t r1, r2, cnt = 0;
+    uint16_t cnt = 0;
     uint16_t delta = 300; // 3 for fast SPI
-    delay(100);
 
-    if (!digitalRead(dreq_pin)) {
+    if (!await_ready()) {
         VS1053_LOGW("VS1053 not properly installed!");
         // Allow testing without the VS1053 module
         pinMode(dreq_pin, INPUT_PULLUP); // DREQ is now input with pull-up
@@ -128,79 +326,214 @@ bool VS1053::testComm(const char *header) {
     // We will use the volume setting for this.
     // Will give warnings on serial output if DEBUG is active.
     // A maximum of 20 errors will be reported.
-    if (strstr(header, "Fast")) {
-        delta = 3; // Fast SPI, more loops
-    }
-
     VS1053_LOGD("%s", header);  // Show a header
 
-    for (i = 0; (i < 0xFFFF) && (cnt < 20); i += delta) {
-        writeRegister(SCI_VOL, i);         // Write data to SCI_VOL
-        r1 = readRegister(SCI_VOL);        // Read back for the first time
-        r2 = readRegister(SCI_VOL);        // Read back a second time
-        if (r1 != r2 || i != r1 || i != r2) // Check for 2 equal reads
-        {
-            VS1053_LOGW("VS1053 error retry SB:%04X R1:%04X R2:%04X", i, r1, r2);
-            cnt++;
-            delay(10);
+    if (!is_full_comm_test) {
+        // quick probe: each bit is tested with 0 and 1
+        const uint16_t values[] = {0xA5A5, 0x5A5A, 0x0000};
+        for (i = 0; i < 3; i++) {
+            if (!test_comm_value(values[i])) cnt++;
+        }
+    } else {
+        if (strstr(header, "Fast")) {
+            delta = 3; // Fast SPI, more loops
+        }
+        for (i = 0; (i < 0xFFFF) && (cnt < 20); i += delta) {
+            if (!test_comm_value(i)) {
+                cnt++;
+                delay(10);
+            }
+            yield(); // Allow ESP firmware to do some bookkeeping
         }
-        yield(); // Allow ESP firmware to do some bookkeeping
     }
     VS1053_LOGD("testComm: %s", cnt==0 ? "OK" : "FAILED");
     return (cnt == 0); // Return the result
 }
 
+bool VS1053::test_comm_value(uint16_t value) {
+    uint16_t r1, r2;
+    writeRegister(SCI_VOL, value);         // Write data to SCI_VOL
+    r1 = readRegister(SCI_VOL);            // Read back for the first time
+    r2 = readRegister(SCI_VOL);            // Read back a second time
+    if (r1 != r2 || value != r1 || value != r2) // Check for 2 equal reads
+    {
+        VS1053_LOGW("VS1053 error retry SB:%04X R1:%04X R2:%04X", value, r1, r2);
+        return false;
+    }
+    return true;
+}
+
+bool VS1053::test_speed(uint8_t reg) {
+    // each bit is tested with 0 and 1
+    const uint16_t values[] = {0xA5A5, 0x5A5A};
+    for (int j = 0; j < 2; j++) {
+        writeRegister(reg, values[j]);
+        if (readRegister(reg) != values[j] || readRegister(reg) != values[j]) return false;
+    }
+    return true;
+}
+
+bool VS1053::calibrateSpeed() {
+    VS1053LockGuard guard(mutex);
+    // SCI_VOL would be audible: SCI_AICTRL0 is unused unless we are recording
+    if (mode == VS1053_IN) {
+        update_clock(readRegister(SCI_CLOCKF));
+        return true;
+    }
+    return calibrate_speed(SCI_AICTRL0);
+}
+
+bool VS1053::calibrate_speed(uint8_t reg) {
+    const uint32_t steps = 4;
+    update_clock(readRegister(SCI_CLOCKF));
+    uint32_t read_max = clki_hz / 7;
+    uint32_t write_max = clki_hz / 4;
+    if (max_speed > 0 && read_max > max_speed) read_max = max_speed;
+    if (max_speed > 0 && write_max > max_speed) write_max = max_speed;
+    uint16_t saved = readRegister(reg);
+
+    // we start with the speeds which are known to work and probe upwards
+    VS1053SpeedProfile result = active_speed;
+    if (result.sci_read > read_max) result.sci_read = read_max;
+    if (result.sci_write > write_max) result.sci_write = write_max;
+    speed_profile = result;
+    // reads: the test values are written with the verified write speed
+    for (uint32_t step = 1; step <= steps; step++) {
+        speed_profile.sci_read = read_max * step / steps;
+        if (speed_profile.sci_read <= result.sci_read) continue;
+        update_speeds();
+        if (!test_speed(reg)) break;
+        result.sci_read = speed_profile.sci_read;
+    }
+    speed_profile.sci_read = result.sci_read;
+    // writes: the test values are read back with the calibrated read speed
+    for (uint32_t step = 1; step <= steps; step++) {
+        speed_profile.sci_write = write_max * step / steps;
+        if (speed_profile.sci_write <= result.sci_write) continue;
+        update_speeds();
+        if (!test_speed(reg)) break;
+        result.sci_write = speed_profile.sci_write;
+    }
+    // SDI has the same timing requirements as SCI writes but can not be read back
+    result.sdi = result.sci_write;
+    setSpeedProfile(result);
+    bool is_ok = test_speed(reg);
+    writeRegister(reg, saved);
+    VS1053_LOGI("SPI speed - CLKI: %u, read: %u, write: %u, sdi: %u", (unsigned)clki_hz,
+                (unsigned)active_speed.sci_read, (unsigned)active_speed.sci_write, (unsigned)active_speed.sdi);
+    return is_ok;
+}
+
+void VS1053::setSpeedProfile(const VS1053SpeedProfile &profile) {
+    VS1053LockGuard guard(mutex);
+    speed_profile = profile;
+    update_speeds();
+}
+
+void VS1053::update_clock(uint16_t clockf) const {
+    // SC_MULT in units of 0.5 x XTALI
+    static const uint8_t multipliers_53[8] = {2, 4, 5, 6, 7, 8, 9, 10};
+    static const uint8_t multipliers_03[8] = {2, 3, 4, 5, 6, 7, 8, 9};
+    // SC_FREQ: 0 is the default XTALI of 12.288 MHz
+    uint16_t freq = clockf & 0x7FF;
+    uint32_t xtali = freq == 0 ? vs1053_xtali_hz : 8000000ul + freq * 4000ul;
+    const uint8_t *multipliers = chip_version == 3 ? multipliers_03 : multipliers_53;
+    clki_hz = xtali / 2 * multipliers[clockf >> 13];
+    update_speeds();
+}
+
+void VS1053::update_speeds() const {
+    uint32_t read_max = clki_hz / 7;
+    uint32_t write_max = clki_hz / 4;
+    active_speed.sci_read = speed_profile.sci_read < read_max ? speed_profile.sci_read : read_max;
+    active_speed.sci_write = speed_profile.sci_write < write_max ? speed_profile.sci_write : write_max;
+    active_speed.sdi = speed_profile.sdi < write_max ? speed_profile.sdi : write_max;
+}
+
+bool VS1053::await_ready() {
+    if (!dreq_wait_busy.await(ready_timeout_ms)) {
+        VS1053_LOGW("VS1053 not ready after %u ms", (unsigned) ready_timeout_ms);
+        return false;
+    }
+    return true;
+}
+
 bool VS1053::begin() {
+    VS1053LockGuard guard(mutex);
     VS1053_LOGD("begin");
     bool result = false;
+    is_started = false;
+    is_clock_pending = false;
+    uint32_t start_us = micros();
+    uint32_t step_us = start_us;
+    startup_timing = VS1053StartupTiming();
     // support for optional custom reset pin when wiring is not possible
     if (reset_pin!=-1){
         pinMode(reset_pin, OUTPUT);
         digitalWrite(reset_pin, HIGH);
-        delay(500);
     }
 
     pinMode(dreq_pin, INPUT); // DREQ is an input
+    dreq_wait_busy.begin(dreq_pin);
+    p_dreq_wait->begin(dreq_pin);
     pinMode(cs_pin, OUTPUT);  // The SCI and SDI signals
     pinMode(dcs_pin, OUTPUT);
     digitalWrite(dcs_pin, HIGH); // Start HIGH for SCI en SDI
     digitalWrite(cs_pin, HIGH);
-    delay(100);
     VS1053_LOGI("Reset...");
     digitalWrite(dcs_pin, LOW); // Low & Low will bring reset pin low
     digitalWrite(cs_pin, LOW);
-    delay(500);
+    delay(1);
     VS1053_LOGI("End reset...");
     digitalWrite(dcs_pin, HIGH); // Back to normal again
     digitalWrite(cs_pin, HIGH);
-    delay(500);
     // Init SPI in slow mode ( 0.2 MHz )
-    p_spi->set_speed(200000);
+    speed_profile = VS1053SpeedProfile();
+    update_clock(0);
+    // DREQ goes high when the chip is ready (after about 1.8 ms)
+    delay(1);
+    await_ready();
+    startup_timing.reset_us = micros() - step_us;
+    step_us = micros();
     // printDetails("Right after reset/startup");
-    delay(20);
-    // printDetails("20 msec after reset");
     if (testComm("Slow SPI,Testing read/write registers...")) {
+        startup_timing.slow_test_us = micros() - step_us;
+        step_us = micros();
         //softReset();
         result = true;
         // Switch on the anaVS1053_LOGD parts
         writeRegister(SCI_AUDATA, 44101); // 44.1kHz stereo
-        // The next clocksetting allows SPI clocking at 5 MHz, 4 MHz is safe then.
-        writeRegister(SCI_CLOCKF, 6 << 12); // Normal clock settings multiplyer 3.0 = 12.2 MHz
-        // SPI Clock to 4 MHz. Now you can set high speed SPI clock.
-        p_spi->set_speed(4000000);
+        // the clock calculation depends on the chip
+        chip_version = getChipVersion();
+        // The clock setting determines the max SPI clock: with 3.0 x 12.288 MHz we can
+        // read with 5 MHz and write with 9 MHz
+        writeRegister(SCI_CLOCKF, clock_setting == VS1053_CLOCK_AUTO ? VS1053_CLOCK_35X_ADD_10X : clock_setting);
+        // Now you can set high speed SPI clock.
+        if (is_speed_calibration) {
+            // nothing is playing yet, so we can use the volume register
+            calibrate_speed(SCI_VOL);
+        } else {
+            VS1053SpeedProfile profile;
+            profile.sci_read = profile.sci_write = profile.sdi = 4000000;
+            setSpeedProfile(profile);
+        }
         writeRegister(SCI_MODE, _BV(SM_SDINEW) | _BV(SM_LINE1));
+        startup_timing.clock_us = micros() - step_us;
+        step_us = micros();
         testComm("Fast SPI, Testing read/write registers again...");
-        delay(10);
-        await_data_request();
+        startup_timing.fast_test_us = micros() - step_us;
         endFillByte = wram_read(0x1E06) & 0xFF;
         VS1053_LOGD("endFillByte is %X", endFillByte);
         //printDetails("After last clocksetting") ;
-        delay(100);
     } 
     mode = VS1053_NA; // default mode
+    p_loaded_patch = nullptr;
+    is_patch_pending = false;
 
     // set and print chip version
     chip_version = getChipVersion();
+    fifo_model.setCapacity(chip_version == 4 ? 2048 : 512);
+    fifo_model.clear();
     switch(chip_version){
         case 3: {
           const char* chip = "VS1003";
@@ -216,16 +549,23 @@ bool VS1053::begin() {
           result = false;
           break;
     }
+    is_started = result;
+    startup_timing.total_us = micros() - start_us;
+    VS1053_LOGI("begin took %u us", (unsigned) startup_timing.total_us);
     return result;
 }
     
 bool VS1053::beginOutput(){
+    VS1053LockGuard guard(mutex);
     VS1053_LOGD("beginOutput");
-    mode = VS1053_OUT;
     begin();
+    // begin() resets the mode
+    mode = VS1053_OUT;
     startSong();
     switchToMp3Mode(); // optional, some boards require this    
-    if (chip_version == 4) { // Only perform an update if we really are using a VS1053, not. eg. VS1003
+    // Only perform an update if we really are using a VS1053, not. eg. VS1003
+    // with lazy patches startSong() has armed the selection from the first audio data
+    if (chip_version == 4 && !is_lazy_patches) {
         loadDefaultVs1053Patches(); 
     }
     return true;
@@ -233,6 +573,7 @@ bool VS1053::beginOutput(){
 
 
 void VS1053::setVolume(uint8_t vol) {
+    VS1053LockGuard guard(mutex);
     // Set volume.  Both left and right.
     // Input value is 0..100.  100 is the loudest.
     uint16_t valueL, valueR; // Values to send to SCI_VOL
@@ -256,6 +597,7 @@ void VS1053::setVolume(uint8_t vol) {
 }
 
 void VS1053::setBalance(int8_t balance) {
+    VS1053LockGuard guard(mutex);
     if (balance > 100) {
         curbalance = 100;
     } else if (balance < -100) {
@@ -266,6 +608,7 @@ void VS1053::setBalance(int8_t balance) {
 }
 
 void VS1053::setTone(uint8_t *rtone) { // Set bass/treble (4 nibbles)
+    VS1053LockGuard guard(mutex);
     // Set tone characteristics.  See documentation for the 4 nibbles.
     uint16_t value = 0; // Value to send to SCI_BASS
     int i;              // Loop control
@@ -285,6 +628,13 @@ int8_t VS1053::getBalance() { // Get the currenet balance setting.
 }
 
 void VS1053::startSong() {
+    VS1053LockGuard guard(mutex);
+    // a new song might be decoded at a different rate
+    fifo_model.clear();
+    // and might need a different clock
+    is_clock_pending = clock_setting == VS1053_CLOCK_AUTO;
+    // and a different patch
+    if (is_lazy_patches && chip_version == 4) is_patch_pending = true;
     sdi_send_fillers(10);
 }
 
@@ -295,6 +645,7 @@ void VS1053::playChunk(uint8_t *data, size_t len) {
 }
 
 void VS1053::stopSong() {
+    VS1053LockGuard guard(mutex);
     uint16_t modereg; // Read from mode register
     int i;            // Loop control
 
@@ -315,18 +666,27 @@ void VS1053::stopSong() {
 }
 
 void VS1053::softReset() {
+    VS1053LockGuard guard(mutex);
     VS1053_LOGI("Performing soft-reset");
     writeRegister(SCI_MODE, _BV(SM_SDINEW) | _BV(SM_RESET));
-    delay(10);
-    await_data_request();
+    delay(1);
+    await_ready();
+    // the FIFO is empty now and the patches need to be loaded again
+    fifo_model.reset();
+    p_loaded_patch = nullptr;
 }
 
 void VS1053::hardReset(){
+    VS1053LockGuard guard(mutex);
     if (reset_pin!=-1){
         VS1053_LOGI("Performing hard-reset");
         digitalWrite(reset_pin, LOW);
-        delay(500);
+        delay(1);
         digitalWrite(reset_pin, HIGH);
+        // the clock multiplier is reset as well
+        update_clock(0);
+        delay(1);
+        await_ready();
     } else {
         VS1053_LOGE("hard-reset only supported when reset_pin is defined");
     }
@@ -343,6 +703,7 @@ void VS1053::hardReset(){
 */
 
 void VS1053::streamModeOn() {
+    VS1053LockGuard guard(mutex);
     VS1053_LOGI("Performing streamModeOn");
     writeRegister(SCI_MODE, _BV(SM_SDINEW) | _BV(SM_STREAM));
     delay(10);
@@ -350,6 +711,7 @@ void VS1053::streamModeOn() {
 }
 
 void VS1053::streamModeOff() {
+    VS1053LockGuard guard(mutex);
     VS1053_LOGI("Performing streamModeOff");
     writeRegister(SCI_MODE, _BV(SM_SDINEW));
     delay(10);
@@ -357,14 +719,18 @@ void VS1053::streamModeOff() {
 }
 
 void VS1053::printDetails(const char *header) {
+    VS1053LockGuard guard(mutex);
     uint16_t regbuf[16];
     uint8_t i;
 
     VS1053_LOGI("%s", header);
     VS1053_LOGI("REG   Contents");
     VS1053_LOGI("---   -----");
-    for (i = 0; i <= SCI_num_registers; i++) {
-        regbuf[i] = readRegister(i);
+    {
+        VS1053SciSession session(*this);
+        for (i = 0; i <= SCI_num_registers; i++) {
+            regbuf[i] = session.read(i);
+        }
     }
     for (i = 0; i <= SCI_num_registers; i++) {
         delay(5);
@@ -381,27 +747,34 @@ void VS1053::printDetails(const char *header) {
  * Read more here: http://www.bajdi.com/lcsoft-vs1053-mp3-module/#comment-33773
  */
 void VS1053::switchToMp3Mode() {
-    wram_write(ADDR_REG_GPIO_DDR_RW, 3); // GPIO DDR = 3
-    wram_write(ADDR_REG_GPIO_ODATA_RW, 0); // GPIO ODATA = 0
-    delay(100);
+    VS1053LockGuard guard(mutex);
+    {
+        VS1053SciSession session(*this);
+        session.wramWrite(ADDR_REG_GPIO_DDR_RW, 3); // GPIO DDR = 3
+        session.wramWrite(ADDR_REG_GPIO_ODATA_RW, 0); // GPIO ODATA = 0
+    }
     VS1053_LOGI("Switched to mp3 mode");
     softReset();
 }
 
 void VS1053::disableI2sOut() {
-    wram_write(ADDR_REG_I2S_CONFIG_RW, 0x0000);
+    VS1053LockGuard guard(mutex);
+    VS1053SciSession session(*this);
+    session.wramWrite(ADDR_REG_I2S_CONFIG_RW, 0x0000);
 
     // configure GPIO0 4-7 (I2S) as input (default)
     // leave other GPIOs unchanged
-    uint16_t cur_ddr = wram_read(ADDR_REG_GPIO_DDR_RW);
-    wram_write(ADDR_REG_GPIO_DDR_RW, cur_ddr & ~0x00f0);
+    uint16_t cur_ddr = session.wramRead(ADDR_REG_GPIO_DDR_RW);
+    session.wramWrite(ADDR_REG_GPIO_DDR_RW, cur_ddr & ~0x00f0);
 }
 
 void VS1053::enableI2sOut(VS1053_I2S_RATE i2sRate) {
+    VS1053LockGuard guard(mutex);
+    VS1053SciSession session(*this);
     // configure GPIO0 4-7 (I2S) as output
     // leave other GPIOs unchanged
-    uint16_t cur_ddr = wram_read(ADDR_REG_GPIO_DDR_RW);
-    wram_write(ADDR_REG_GPIO_DDR_RW, cur_ddr | 0x00f0);
+    uint16_t cur_ddr = session.wramRead(ADDR_REG_GPIO_DDR_RW);
+    session.wramWrite(ADDR_REG_GPIO_DDR_RW, cur_ddr | 0x00f0);
 
     uint16_t i2s_config = 0x000c; // Enable MCLK(3); I2S(2)
     switch (i2sRate) {
@@ -417,7 +790,7 @@ void VS1053::enableI2sOut(VS1053_I2S_RATE i2sRate) {
             break;
     }
 
-    wram_write(ADDR_REG_I2S_CONFIG_RW, i2s_config );
+    session.wramWrite(ADDR_REG_I2S_CONFIG_RW, i2s_config );
 }
 
 /**
@@ -483,14 +856,15 @@ void VS1053::clearDecodedTime() {
  * Fine tune the data rate
  */
 void VS1053::adjustRate(long ppm2) {
-    writeRegister(SCI_WRAMADDR, 0x1e07);
-    writeRegister(SCI_WRAM, ppm2);
-    writeRegister(SCI_WRAM, ppm2 >> 16);
+    VS1053LockGuard guard(mutex);
+    VS1053SciSession session(*this);
+    session.write(SCI_WRAMADDR, 0x1e07);
+    session.write(SCI_WRAM, ppm2);
+    session.write(SCI_WRAM, ppm2 >> 16);
     // oldClock4KHz = 0 forces  adjustment calculation when rate checked.
-    writeRegister(SCI_WRAMADDR, 0x5b1c);
-    writeRegister(SCI_WRAM, 0);
+    session.wramWrite(0x5b1c, 0);
     // Write to AUDATA or CLOCKF checks rate and recalculates adjustment.
-    writeRegister(SCI_AUDATA, readRegister(SCI_AUDATA));
+    session.write(SCI_AUDATA, session.read(SCI_AUDATA));
 }
 
 /**
@@ -509,7 +883,11 @@ void VS1053::adjustRate(long ppm2) {
  * the method is called by loadUserCode(plugin_myname, sizeof(plugin_myname)/sizeof(plugin_myname[0]))
  */
 void VS1053::loadUserCode(const unsigned short* plugin, unsigned short plugin_size) {
+    VS1053LockGuard guard(mutex);
     VS1053_LOGI("Loading User Code");
+    // the VS1053 supports SCI multiple writes: so we can send the runs w/o raising xCS
+    bool is_multiple_write = chip_version == 4;
+    VS1053SciSession session(*this, true);
     int i = 0;
     while (i < plugin_size) {
         unsigned short addr, n, val;
@@ -518,13 +896,22 @@ void VS1053::loadUserCode(const unsigned short* plugin, unsigned short plugin_si
         if (n & 0x8000U) { /* RLE run, replicate n samples */
             n &= 0x7FFF;
             val = plugin[i++];
-            while (n--) {
-                writeRegister(addr, val);
+            if (is_multiple_write) {
+                session.writeRepeat(addr, val, n);
+            } else {
+                while (n--) {
+                    session.write(addr, val);
+                }
             }
         } else {           /* Copy run, copy n samples */
-            while (n--) {
-                val = plugin[i++];
-                writeRegister(addr, val);
+            if (is_multiple_write) {
+                session.writeMultiple(addr, plugin + i, n);
+                i += n;
+            } else {
+                while (n--) {
+                    val = plugin[i++];
+                    session.write(addr, val);
+                }
             }
         }
     }
@@ -535,16 +922,76 @@ void VS1053::loadUserCode(const unsigned short* plugin, unsigned short plugin_si
  * Load the latest generic firmware patch
  */
 bool VS1053::loadDefaultVs1053Patches() {
+    VS1053_LOGD("loadDefaultVs1053Patches");
+    return loadPatch(VS1053_PATCH_BASE);
+}
+
+bool VS1053::loadPatch(uint8_t capabilities) {
+    VS1053LockGuard guard(mutex);
 #if USE_PATCHES
-    if (getChipVersion() == 4) { // Only perform an update if we really are using a VS1053, not. eg. VS1003
-        VS1053_LOGD("loadDefaultVs1053Patches");
-        loadUserCode(PATCHES, PATCHES_SIZE);
-        return true;
-    } else {
+    if (chip_version != 4) { // Only perform an update if we really are using a VS1053, not. eg. VS1003
         VS1053_LOGE("Patches only supported for VS1053");
+        return false;
     }
-#endif
+    const VS1053Patch *patch = VS1053PatchRegistry::find(capabilities);
+    if (patch == nullptr) {
+        VS1053_LOGE("No patch available for %x", capabilities);
+        return false;
+    }
+    if (patch == p_loaded_patch) return true;
+    // the patches can only be loaded into a clean state
+    if (p_loaded_patch != nullptr) softReset();
+    VS1053_LOGI("Loading patch %s (%d words)", patch->name, patch->size);
+    loadUserCode(patch->data, patch->size);
+    p_loaded_patch = patch;
+    return true;
+#else
     return false;
+#endif
+}
+
+/// Lazy patch loading: selects the patch from the first bytes of the audio data
+void VS1053::load_patch_for(const uint8_t *data, size_t len) {
+    is_patch_pending = false;
+    loadPatch(VS1053PatchRegistry::sniff(data, len));
+}
+
+void VS1053::setClock(VS1053_CLOCK clock) {
+    VS1053LockGuard guard(mutex);
+    clock_setting = clock;
+    // otherwise the clock is set by begin()
+    if (!is_started) return;
+    if (clock == VS1053_CLOCK_AUTO) {
+        is_clock_pending = mode == VS1053_OUT;
+    } else {
+        is_clock_pending = false;
+        apply_clock(clock);
+    }
+}
+
+VS1053_CLOCK VS1053::clockFor(const uint8_t *data, size_t len) {
+    // FLAC (native or in Ogg) and Ogg Vorbis need the max clock
+    if (VS1053PatchRegistry::sniff(data, len) & VS1053_PATCH_FLAC) return VS1053_CLOCK_45X;
+    if (len >= 4 && memcmp(data, "OggS", 4) == 0) return VS1053_CLOCK_45X;
+    // MP3, AAC, WMA: the decoder adds 1.0 x for demanding streams
+    return VS1053_CLOCK_35X_ADD_10X;
+}
+
+void VS1053::apply_clock(uint16_t clockf) {
+    // keep SC_FREQ
+    uint16_t current = readRegister(SCI_CLOCKF);
+    uint16_t value = (clockf & 0xF800) | (current & 0x07FF);
+    if (value == current) return;
+    VS1053_LOGI("SCI_CLOCKF: %x", value);
+    writeRegister(SCI_CLOCKF, value);
+    // a lower clock has already reduced the SPI clocks: a higher clock allows faster ones
+    if (is_speed_calibration && (value >> 13) > (current >> 13)) calibrateSpeed();
+}
+
+/// Automatic clock: selects the clock from the first bytes of the audio data
+void VS1053::apply_clock_for(const uint8_t *data, size_t len) {
+    is_clock_pending = false;
+    apply_clock(clockFor(data, len));
 }
 
 /// Provides the treble amplitude value
@@ -554,6 +1001,7 @@ uint8_t VS1053::treble() {
 
 /// Sets the treble amplitude value (range 0 to 100)
 void VS1053::setTreble(uint8_t value){
+    VS1053LockGuard guard(mutex);
     if (value>100) value = 100;
     equilizer.treble().amplitude = value;
     writeRegister(SCI_BASS, equilizer.value());
@@ -566,6 +1014,7 @@ uint8_t VS1053::bass() {
 
 /// Sets the bass amplitude value (range 0 to 100)
 void VS1053::setBass(uint8_t value){
+    VS1053LockGuard guard(mutex);
     if (value>100) value = 100;
     equilizer.bass().amplitude = value;
     writeRegister(SCI_BASS, equilizer.value());
@@ -573,34 +1022,38 @@ void VS1053::setBass(uint8_t value){
 
 /// Sets the treble frequency limit in hz (range 0 to 15000)
 void VS1053::setTrebleFrequencyLimit(uint16_t value){
+    VS1053LockGuard guard(mutex);
     equilizer.treble().freq_limit = value;
     writeRegister(SCI_BASS, equilizer.value());
 }
 
 /// Sets the bass frequency limit in hz (range 0 to 15000)
 void VS1053::setBassFrequencyLimit(uint16_t value){
+    VS1053LockGuard guard(mutex);
     equilizer.bass().freq_limit = value;
     writeRegister(SCI_BASS, equilizer.value());
 }
 
 bool VS1053::setEarSpeaker(VS1053_EARSPEAKER value){
-    if (getChipVersion()!=4){
+    VS1053LockGuard guard(mutex);
+    VS1053SciSession session(*this);
+    if (((session.read(SCI_STATUS) & 0x00F0) >> 4) != 4){
         VS1053_LOGE("Function not supported");
         return false;
     }
-    int16_t mode = readRegister(SCI_MODE);
+    int16_t mode = session.read(SCI_MODE);
     switch(value){
         case VS1053_EARSPEAKER_MAX:
-            writeRegister(SCI_MODE, mode | (SC_EAR_SPEAKER_HI | SC_EAR_SPEAKER_LO)); // extreme 3 - on on
+            session.write(SCI_MODE, mode | (SC_EAR_SPEAKER_HI | SC_EAR_SPEAKER_LO)); // extreme 3 - on on
             break;
         case VS1053_EARSPEAKER_ON:
-            writeRegister(SCI_MODE, (mode | SC_EAR_SPEAKER_HI) & (~SC_EAR_SPEAKER_LO)); // normal 2 - off on
+            session.write(SCI_MODE, (mode | SC_EAR_SPEAKER_HI) & (~SC_EAR_SPEAKER_LO)); // normal 2 - off on
             break;
         case VS1053_EARSPEAKER_MIN:
-            writeRegister(SCI_MODE, (mode | SC_EAR_SPEAKER_LO) & (~SC_EAR_SPEAKER_HI)); // minimal 1 - on off
+            session.write(SCI_MODE, (mode | SC_EAR_SPEAKER_LO) & (~SC_EAR_SPEAKER_HI)); // minimal 1 - on off
             break;
         case VS1053_EARSPEAKER_OFF:
-            writeRegister(SCI_MODE, (mode & (~SC_EAR_SPEAKER_HI)) & (~SC_EAR_SPEAKER_LO)); // off 0 - off off
+            session.write(SCI_MODE, (mode & (~SC_EAR_SPEAKER_HI)) & (~SC_EAR_SPEAKER_LO)); // off 0 - off off
             break;
     }
     return true;
@@ -609,6 +1062,7 @@ bool VS1053::setEarSpeaker(VS1053_EARSPEAKER value){
 
 /// Stops the recording of sound
 void VS1053::end() {
+    VS1053LockGuard guard(mutex);
     // clear SM_ADPCM bit
     uint16_t mode = readRegister(SCI_MODE);
     set_flag(mode, 1<<SM_ADPCM, false); // stop recoring
@@ -619,6 +1073,7 @@ void VS1053::end() {
 #if USE_MIDI
 
 bool VS1053::beginMidi() {
+    VS1053LockGuard guard(mutex);
     VS1053_LOGI("beginMIDI");
     bool result = false;           
     // initialize the player
@@ -642,13 +1097,19 @@ bool VS1053::beginMidi() {
            break;
     }
 
-    delay(500);
+    midi_queue.clear();
+    midi_queue.resetRunningStatus();
+
     // check if midi is active
-    int check = readRegister(SCI_AUDATA);
-    if (check==0xac45){
-        mode = VS1053_MIDI;
-        result = true;
-    }
+    uint32_t start = millis();
+    do {
+        if (readRegister(SCI_AUDATA) == 0xac45){
+            mode = VS1053_MIDI;
+            result = true;
+            break;
+        }
+        delay(1);
+    } while (millis() - start < 500);
     VS1053_LOGI("Midi %s", result ? "active":"inactive");
     return result;
 }
@@ -664,57 +1125,157 @@ bool VS1053::beginMidi() {
  */
  
 void VS1053::sendMidiMessage(uint8_t cmd, uint8_t data1, uint8_t data2) {
-     if (mode != VS1053_MIDI){
+    VS1053LockGuard guard(mutex);
+    uint8_t msg[3] = {cmd, data1, data2};
+    // Some commands only have one data byte (http://253.ccarh.org/handout/midiprotocol/)
+    sendMidi(msg, 1 + VS1053MidiQueue::dataLength(cmd));
+}
+
+void VS1053::sendMidi(const uint8_t *msg, size_t len) {
+    VS1053LockGuard guard(mutex);
+    if (mode != VS1053_MIDI){
         VS1053_LOGE("beginMidi not called");
         return;
-     }
-    int len = 4;
-    uint8_t data[6] ={0x00, cmd, 0x00, data1};
-    // Some commands only have one data byte. All cmds less than 0xBn have 2 data bytes 
-    // (sort of: http://253.ccarh.org/handout/midiprotocol/)
-    if( (cmd & 0xF0) <= 0xB0 || (cmd & 0xF0) >= 0xE0) {
-      data[4]=0x00;
-      data[5]=data2;
-      len = 6;
-    } 
-    sdi_send_buffer(data, len);
+    }
+    if (len == 0) return;
+    // running status: we can omit the status byte if it is the same as in the last message
+    if (midi_queue.isRunningStatus(msg[0])){
+        msg++;
+        len--;
+    }
+    while (len > 0){
+        size_t n = midi_queue.write(msg, len);
+        msg += n;
+        len -= n;
+        if (len > 0) flushMidi();
+    }
+    if (!is_midi_batch) flushMidi();
+}
+
+void VS1053::endMidiBatch() {
+    VS1053LockGuard guard(mutex);
+    is_midi_batch = false;
+    flushMidi();
+}
+
+void VS1053::flushMidi() {
+    VS1053LockGuard guard(mutex);
+    if (midi_queue.size() == 0) return;
+    sdi_send_midi(midi_queue.data(), midi_queue.size());
+    midi_queue.clear();
 }
 
 #endif
 
 void VS1053::writeAudio(uint8_t*data, size_t len){
+      VS1053LockGuard guard(mutex);
+      if (is_clock_pending) apply_clock_for(data, len);
+      if (is_patch_pending) load_patch_for(data, len);
+      sdi_write_audio(data, len);
+}
+
+void VS1053::sdi_write_audio(uint8_t *data, size_t len) {
       if (mode == VS1053_MIDI){
-          // Convert to 16-bit big-endian (0x00, data[i]) in small chunks to avoid large stack usage
-          const size_t chunk = vs1053_chunk_size; // 32
-          uint8_t tmp[vs1053_chunk_size * 2];
-          const uint8_t *p = data;
-          size_t remaining = len;
-          while (remaining) {
-                size_t n = remaining > chunk ? chunk : remaining;
-                for (size_t i = 0; i < n; ++i) {
-                     tmp[i * 2] = 0x00;
-                     tmp[i * 2 + 1] = p[i];
-                }
-                sdi_send_buffer(tmp, n * 2);
-                p += n;
-                remaining -= n;
-          }
+#if USE_MIDI
+          // keep the order and we do not know the running status after the raw data
+          flushMidi();
+          midi_queue.resetRunningStatus();
+#endif
+          sdi_send_midi(data, len);
       } else {
           sdi_send_buffer(data, len);
       }
 }
 
+/// Writes a chunk in data mode: in MIDI mode the chunk must not be bigger then half the chunk size
+void VS1053::sdi_write_chunk(const uint8_t *data, size_t len) {
+    if (mode == VS1053_MIDI) {
+        p_spi->write_interleaved(0x00, data, len);
+        p_dreq_wait->onData(len * 2);
+        fifo_sent(len * 2);
+    } else {
+        p_spi->write_bytes(const_cast<uint8_t *>(data), len);
+        p_dreq_wait->onData(len);
+        fifo_sent(len);
+    }
+}
+
+size_t VS1053::writeAudioNonBlocking(const uint8_t *data, size_t len) {
+    VS1053LockGuard guard(mutex);
+    // in midi mode each byte is sent as 16 bit word
+    const size_t chunk = mode == VS1053_MIDI ? vs1053_chunk_size / 2 : vs1053_chunk_size;
+    size_t result = 0;
+    if (len == 0) return 0;
+    if (is_clock_pending) apply_clock_for(data, len);
+    if (is_patch_pending) load_patch_for(data, len);
+    if (!digitalRead(dreq_pin)) {
+        // DREQ might also be low because the chip is still busy with a SCI operation
+        if (is_burst_mode && !is_sci_pending) fifo_model.full(micros());
+        return 0;
+    }
+#if USE_MIDI
+    // we do not know the running status after the raw data
+    if (mode == VS1053_MIDI) midi_queue.resetRunningStatus();
+#endif
+
+    data_mode_on();
+    do {
+        size_t n = len - result > chunk ? chunk : len - result;
+        sdi_write_chunk(data + result, n);
+        result += n;
+    } while (result < len && digitalRead(dreq_pin));
+    data_mode_off();
+    return result;
+}
+
+size_t VS1053::write(const uint8_t *data, size_t len) {
+    return writeAudioNonBlocking(data, len);
+}
+
+size_t VS1053::write(uint8_t data) {
+    return writeAudioNonBlocking(&data, 1);
+}
+
+int VS1053::availableForWrite() {
+    if (!digitalRead(dreq_pin)) return 0;
+    // DREQ guarantees space for at least 32 bytes
+    return mode == VS1053_MIDI ? vs1053_chunk_size / 2 : vs1053_chunk_size;
+}
+
 /// Starts the recording of sound as WAV data
 bool VS1053::beginInput(VS1053Recording &opt) {
+    VS1053LockGuard guard(mutex);
     VS1053_LOGI("beginInput");
     bool result = false;
 
     // regular setup
     begin();
 
+    // IMA ADPCM is provided in blocks of 128 words per channel
+    record_block_words = opt.format()==VS1053_ADPCM ? VS1053ADPCM::block_size / 2 * opt.channels() : 1;
+    record_format = opt.format();
+    is_input_stopping = false;
+    is_input_finished = false;
+
+    if (opt.format()==VS1053_OGG){
+        if (chip_version!=4){
+            VS1053_LOGE("Ogg Vorbis encoding is only supported by the vs1053");
+            return false;
+        }
+        result = begin_input_ogg(opt);
+        mode = VS1053_IN;
+        // VBR: we assume twice the nominal bitrate and 256 kbit/s if only the quality is defined
+        record_words_per_second = opt.bitrate_kbps > 0 ? opt.bitrate_kbps * 1000 / 8 : 256000 / 16;
+        schedule_read(0, micros());
+        return result;
+    }
+
+    uint8_t channels = opt.channels();
     switch (chip_version){
         case 3:
             result = begin_input_vs1003(opt);
+            record_block_words = opt.format()==VS1053_ADPCM ? VS1053ADPCM::block_size / 2 : 1;
+            channels = 1; // the VS1003 records in mono
             mode = VS1053_IN;
             break;
 
@@ -728,6 +1289,12 @@ bool VS1053::beginInput(VS1053Recording &opt) {
             result =false;
             break;
     }
+
+    record_words_per_second = opt.sampleRate() * channels;
+    if (opt.format()==VS1053_ADPCM){
+        record_words_per_second = record_words_per_second * (VS1053ADPCM::block_size / 2) / VS1053ADPCM::samples_per_block;
+    }
+    schedule_read(0, micros());
     return result;
 }
 
@@ -735,27 +1302,30 @@ bool VS1053::beginInput(VS1053Recording &opt) {
 bool VS1053::begin_input_vs1053(VS1053Recording &opt){
 #ifdef USE_INPUT
     VS1053_LOGD("%s",__func__);
-    // clear SM_ADPCM bit
-    writeRegister(SCI_AICTRL0, opt.sampleRate());
-    writeRegister(SCI_AICTRL1, opt.recordingGain());
-    writeRegister(SCI_AICTRL2, opt.autoGainAmplification());
-
-    // setup SCI_AICTRL3
-    uint16_t ctrl3=0;
-    if (opt.channels()==2){
-        ctrl3 = 0; // joint stereo 
-    } else {
-        ctrl3 = opt.input==VS1053_AUX ? 3 : 2;  // select left or right channel
-    }
-    set_flag(ctrl3, 1<<2, 1); // Linear PCM Mode
-    writeRegister(SCI_AICTRL3, ctrl3); 
+    {
+        VS1053SciSession session(*this);
+        // clear SM_ADPCM bit
+        session.write(SCI_AICTRL0, opt.sampleRate());
+        session.write(SCI_AICTRL1, opt.recordingGain());
+        session.write(SCI_AICTRL2, opt.autoGainAmplification());
+
+        // setup SCI_AICTRL3
+        uint16_t ctrl3=0;
+        if (opt.channels()==2){
+            ctrl3 = 0; // joint stereo 
+        } else {
+            ctrl3 = opt.input==VS1053_AUX ? 3 : 2;  // select left or right channel
+        }
+        set_flag(ctrl3, 1<<2, opt.format()==VS1053_PCM); // Linear PCM or IMA ADPCM Mode
+        session.write(SCI_AICTRL3, ctrl3); 
 
-    uint16_t mode = readRegister(SCI_MODE);
-    set_flag(mode, 1<<SM_ADPCM, true); // activate pcm mode
-    set_flag(mode, 1<<SM_RESET, true);
-    set_flag(mode, 1<<SM_LINE1, opt.input==VS1053_AUX);
+        uint16_t mode = session.read(SCI_MODE);
+        set_flag(mode, 1<<SM_ADPCM, true); // activate pcm mode
+        set_flag(mode, 1<<SM_RESET, true);
+        set_flag(mode, 1<<SM_LINE1, opt.input==VS1053_AUX);
 
-    writeRegister(SCI_MODE, mode);
+        session.write(SCI_MODE, mode);
+    }
 
     loadUserCode(pcm1053, PLUGIN_SIZE_pcm1053);   
 
@@ -766,15 +1336,62 @@ bool VS1053::begin_input_vs1053(VS1053Recording &opt){
 #endif
 }
 
+bool VS1053::begin_input_ogg(VS1053Recording &opt){
+    VS1053_LOGD("%s",__func__);
+    if (opt.p_encoder==nullptr && opt.p_encoder_stream==nullptr){
+        VS1053_LOGE("No Ogg Vorbis encoder plugin defined");
+        return false;
+    }
+    // the encoder needs the max clock: 4.5 x XTALI
+    writeRegister(SCI_CLOCKF, VS1053_CLOCK_45X);
+    await_ready();
+    {
+        VS1053SciSession session(*this);
+        session.write(SCI_BASS, 0);
+        session.wramWrite(0xC01A, 0x0002); // disable all interrupts except SCI
+    }
+
+    if (opt.p_encoder!=nullptr){
+        loadUserCode(opt.p_encoder, opt.encoder_size);
+    } else {
+        VS1053PluginLoader loader(*this);
+        if (!loader.load(*opt.p_encoder_stream)){
+            VS1053_LOGE("Could not load the Ogg Vorbis encoder");
+            return false;
+        }
+    }
+
+    {
+        VS1053SciSession session(*this);
+        uint16_t mode = session.read(SCI_MODE);
+        set_flag(mode, 1<<SM_ADPCM, true);
+        set_flag(mode, 1<<SM_LINE1, opt.input==VS1053_AUX);
+        session.write(SCI_MODE, mode);
+        session.write(SCI_AICTRL1, opt.recordingGain());
+        session.write(SCI_AICTRL2, opt.autoGainAmplification());
+        session.write(SCI_AICTRL3, 0);
+        session.write(SCI_WRAMADDR, opt.encoderProfile());
+        // start the encoder application
+        session.write(SCI_AIADDR, 0x0034);
+    }
+    return true;
+}
+
 bool VS1053::begin_input_vs1003(VS1053Recording &opt){
     VS1053_LOGD("%s",__func__);
-    // we might need to repeat some values per channel
-    channels_multiplier = opt.channels();
+    if (opt.format()==VS1053_ADPCM){
+        // the VS1003 records IMA ADPCM in mono w/o patch
+        channels_multiplier = 1;
+        opt.setChannels(1);
+    } else {
+        // we might need to repeat some values per channel
+        channels_multiplier = opt.channels();
 
 //1) Load the patch using either the plugin format (vs1003b-pcm.plg)
 //   or the loading tables (vs1003b-pcm.c)
-    loadUserCode(pcm1003, PLUGIN_SIZE_pcm1003);   
-    delay(100);
+        loadUserCode(pcm1003, PLUGIN_SIZE_pcm1003);   
+        await_ready();
+    }
 
 //2) Configure the encoding normally, for example
 //   CLOCKF=0x4000
@@ -788,32 +1405,36 @@ bool VS1053::begin_input_vs1003(VS1053Recording &opt){
         VS1053_LOGD("Could not set sample rate");
         return false;
     }
-    int16_t clock_freq = readRegister(SCI_CLOCKF) & 0x3FF;
-    int16_t sci_clockf = clock_freq | calc.getMultiplierRegisterValue() ;
-    VS1053_LOGD("clock_freq: %x", clock_freq);
-    VS1053_LOGD("multipler: %x -  %f", calc.getMultiplierRegisterValue(), calc.getMultiplier());
-    VS1053_LOGD("SCI_CLOCKF: %x", sci_clockf);
-    VS1053_LOGD("divider: %d", calc.getDivider());
-    VS1053_LOGD("sample_rate: %d", opt.sample_rate);
-    VS1053_LOGD("sample_rate eff: %d", sample_rate_calc);
-
-    writeRegister(SCI_CLOCKF, sci_clockf ); // e.g. 0x4430
-    delay(100);
-    writeRegister(SCI_AICTRL0, calc.getDivider()); // e.g. 12 / clock divider: -> 12=8kHz 8=12kHz 6=16kHz 
-    delay(100);
-    writeRegister(SCI_AICTRL1, opt.recording_gain);
-    delay(100);
-
-    // setting mic or aux as input
-    uint16_t sci_mode = readRegister(SCI_MODE);
-    set_flag(sci_mode, 1<<SM_ADPCM, true);
-    set_flag(sci_mode, 1<<SM_LINE1, opt.input==VS1053_AUX);
-    writeRegister(SCI_MODE, sci_mode);
-    delay(100);
+    {
+        VS1053SciSession session(*this);
+        int16_t clock_freq = session.read(SCI_CLOCKF) & 0x3FF;
+        int16_t sci_clockf = clock_freq | calc.getMultiplierRegisterValue() ;
+        VS1053_LOGD("clock_freq: %x", clock_freq);
+        VS1053_LOGD("multipler: %x -  %f", calc.getMultiplierRegisterValue(), calc.getMultiplier());
+        VS1053_LOGD("SCI_CLOCKF: %x", sci_clockf);
+        VS1053_LOGD("divider: %d", calc.getDivider());
+        VS1053_LOGD("sample_rate: %d", opt.sample_rate);
+        VS1053_LOGD("sample_rate eff: %d", sample_rate_calc);
+        session.write(SCI_CLOCKF, sci_clockf ); // e.g. 0x4430
+    }
+    // give the clock time to settle
+    await_ready();
+    {
+        VS1053SciSession session(*this);
+        session.write(SCI_AICTRL0, calc.getDivider()); // e.g. 12 / clock divider: -> 12=8kHz 8=12kHz 6=16kHz 
+        session.write(SCI_AICTRL1, opt.recording_gain);
+
+        // setting mic or aux as input
+        uint16_t sci_mode = session.read(SCI_MODE);
+        set_flag(sci_mode, 1<<SM_ADPCM, true);
+        set_flag(sci_mode, 1<<SM_LINE1, opt.input==VS1053_AUX);
+        session.write(SCI_MODE, sci_mode);
+    }
+    await_ready();
 
 //3) Start the encoding mode by writing AIADDR=0x0030
     writeRegister(SCI_AIADDR, 0x0030);
-    delay(100);
+    await_ready();
 
     // inform api about used sample rate
     opt.sample_rate = sample_rate_calc;
@@ -823,34 +1444,105 @@ bool VS1053::begin_input_vs1003(VS1053Recording &opt){
 
 /// Provides the number of bytes which are available in the read buffer
 size_t VS1053::available() {
-    if (mode!=VS1053_IN) return 0;
+    VS1053LockGuard guard(mutex);
+    if (mode!=VS1053_IN || is_input_finished) return 0;
 
-    size_t available = readRegister(SCI_HDAT1)*2;
-    if (available>1024*2){
-        //VS1053_LOGD("Invalid value: %d", available);
-        available = 0; //1024*2;
-    }
-    return available * channels_multiplier;
+    size_t words = record_words(readRegister(SCI_HDAT1));
+    // ADPCM data is only provided in complete blocks
+    words -= words % record_block_words;
+    return words * 2 * channels_multiplier;
 }
 
 /// Provides the audio data as PCM data
 size_t VS1053::readBytes(uint8_t*data, size_t len){
-    if (mode!=VS1053_IN) return 0;
-
-    size_t to_read = min(len, available());
-    size_t result = 0;
-    int16_t *p_word = (int16_t*)data;
-    size_t max_samples = to_read / 2 / channels_multiplier;
-    for (size_t i = 0; i < max_samples; i++){
-        int16_t tmp = readRegister(SCI_HDAT0);
-        for (uint8_t ch = 0; ch < channels_multiplier; ch++){
-            *p_word++ = tmp;
-            result += 2;
+    VS1053LockGuard guard(mutex);
+    if (mode!=VS1053_IN || is_input_finished) return 0;
+
+    // one transaction for the whole block: HDAT1 is only read once
+    VS1053SciSession session(*this);
+    // after a stop request the encoder reports the end in AICTRL3 bit 1 (bit 2: the last word has only 1 byte)
+    uint16_t ctrl3 = is_input_stopping ? session.read(SCI_AICTRL3) : 0;
+    bool is_encoder_done = ctrl3 & 2;
+    uint32_t words_us = micros();
+    size_t words = record_words(session.read(SCI_HDAT1));
+    size_t max_samples = min(len / 2 / channels_multiplier, words);
+    // ADPCM data is only provided in complete blocks
+    max_samples -= max_samples % record_block_words;
+    // keep the last word until we know if it is complete
+    if (is_input_stopping && !is_encoder_done && max_samples == words && max_samples > 0) max_samples--;
+    uint16_t *p_word = (uint16_t*)data;
+    session.readMultiple(SCI_HDAT0, p_word, max_samples);
+    if (record_format != VS1053_PCM){
+        // the ADPCM and Ogg bytes are in big endian order
+        for (size_t i = 0; i < max_samples; i++){
+            uint16_t word = p_word[i];
+            data[i * 2] = word >> 8;
+            data[i * 2 + 1] = word & 0xFF;
+        }
+    }
+    // repeat the values for multiple channels: we start at the end so that we do not overwrite unprocessed values
+    if (channels_multiplier > 1){
+        for (size_t i = max_samples; i-- > 0;){
+            for (uint8_t ch = 0; ch < channels_multiplier; ch++){
+                p_word[i * channels_multiplier + ch] = p_word[i];
+            }
         }
     }
+    if (max_samples > 0) record_stats.reads++;
+    schedule_read(words - max_samples, words_us);
+    size_t result = max_samples * 2 * channels_multiplier;
+    if (is_encoder_done && max_samples == words){
+        is_input_finished = true;
+        if ((ctrl3 & 4) && result > 0) result--;
+    }
     return result;
 }
 
+/// Validates the number of words reported by SCI_HDAT1 and updates the recording counters
+size_t VS1053::record_words(size_t words){
+    if (words > record_buffer_words){
+        VS1053_LOGW("Invalid number of recorded words: %d", (int)words);
+        record_stats.invalid++;
+        return 0;
+    }
+    if (words == record_buffer_words){
+        VS1053_LOGW("Recording buffer overrun");
+        record_stats.overruns++;
+    }
+    if (words > record_stats.high_water) record_stats.high_water = words;
+    return words;
+}
+
+/// Determines when the recording buffer reaches the fill target: remaining_words were left at time_us
+void VS1053::schedule_read(size_t remaining_words, uint32_t time_us){
+    size_t target = (size_t)record_buffer_words * record_target_percent / 100;
+    uint32_t delay_us = 0;
+    if (record_words_per_second > 0 && remaining_words < target){
+        delay_us = (uint64_t)(target - remaining_words) * 1000000 / record_words_per_second;
+    }
+    next_read_us = time_us + delay_us;
+}
+
+uint32_t VS1053::nextReadDelay(){
+    int32_t result = (int32_t)(next_read_us - micros());
+    return result > 0 ? result : 0;
+}
+
+/// Ends the recording
+void VS1053::stopInput(){
+    VS1053LockGuard guard(mutex);
+    if (mode!=VS1053_IN) return;
+    if (record_format!=VS1053_OGG){
+        is_input_finished = true;
+        return;
+    }
+    // ask the encoder to finish the stream: the remaining data is provided by readBytes()
+    VS1053SciSession session(*this);
+    uint16_t ctrl3 = session.read(SCI_AICTRL3);
+    session.write(SCI_AICTRL3, ctrl3 | 1);
+    is_input_stopping = true;
+}
+
 }
 
 
@@ -45,7 +45,13 @@
 #include "VS1053Config.h"
 #include "VS1053Logger.h"
 #include "VS1053SPI.h"
+#include "VS1053DreqWait.h"
+#include "VS1053FifoModel.h"
+#include "VS1053Patches.h"
 #include "VS1053Recording.h"
+#include "VS1053ADPCM.h"
+#include "VS1053MidiQueue.h"
+#include "VS1053Mutex.h"
 #include "patches/vs1053b-patches.h"
 #include "patches_in/vs1003b-pcm.h"
 #include "patches_in/vs1053b-pcm.h"
@@ -84,11 +90,53 @@ enum VS1053_EARSPEAKER {
     VS1053_EARSPEAKER_MAX
 };
 
+/// Clock settings: SCI_CLOCKF values with the SC_MULT and SC_ADD bits of the VS1053
+enum VS1053_CLOCK {
+    VS1053_CLOCK_30X = 0x6000,          // 3.0 x XTALI (default)
+    VS1053_CLOCK_35X_ADD_10X = 0x8800,  // 3.5 x XTALI, +1.0 x when the decoder needs it (up to 4.5 x)
+    VS1053_CLOCK_45X = 0xC000,          // 4.5 x XTALI: FLAC, Ogg Vorbis
+    VS1053_CLOCK_AUTO = 0xFFFF          // selected from the first bytes of each song
+};
+
+/// When do we wait for the completion (DREQ) of a SCI operation
+enum VS1053_COMPLETION {
+    VS1053_COMPLETION_NONE,     // no wait
+    VS1053_COMPLETION_AFTER,    // wait right after the operation
+    VS1053_COMPLETION_DEFERRED  // wait before the next SCI or SDI operation
+};
+
+/// Time in microseconds which was needed by the individual steps of begin()
+struct VS1053StartupTiming {
+    uint32_t reset_us = 0;      // reset until DREQ is high
+    uint32_t slow_test_us = 0;  // communication test with slow SPI
+    uint32_t clock_us = 0;      // clock and mode setup
+    uint32_t fast_test_us = 0;  // communication test with fast SPI
+    uint32_t total_us = 0;      // complete begin()
+};
+
+/// SPI clock in Hz which is used for the different kinds of transfers
+struct VS1053SpeedProfile {
+    uint32_t sci_read = 200000;     // SCI read operations: legal up to CLKI/7
+    uint32_t sci_write = 200000;    // SCI write operations: legal up to CLKI/4
+    uint32_t sdi = 200000;          // SDI data: legal up to CLKI/4
+};
+
+/// Counters of the recording buffer of the chip
+struct VS1053RecordingStats {
+    uint32_t reads = 0;         // readBytes() calls which provided data
+    uint32_t overruns = 0;      // the recording buffer was full, so data was lost
+    uint32_t invalid = 0;       // SCI_HDAT1 reported more words than the buffer can hold
+    uint16_t high_water = 0;    // max number of words which were waiting in the buffer
+};
+
 /**
- * @brief Main class for controlling VS1053 and VS1003 modules
- * 
+ * @brief Main class for controlling VS1053 and VS1003 modules. With USE_TASKS the
+ * public methods which access the chip are serialized with a mutex, so they can be
+ * called while a VS1053Feeder or VS1053Capture task is active.
  */
 class VS1053 {
+    friend class VS1053SciSession;
+    friend class VS1053PluginLoader;
 
     /**
      * @brief Amplitude and Frequency Limit 
@@ -212,7 +260,7 @@ class VS1053 {
         int divider = -1;
         int multiplier = -1;
         const uint16_t sc_multipliers[7] = { SC_1003_MULT_2,SC_1003_MULT_25,SC_1003_MULT_3, SC_1003_MULT_35, SC_1003_MULT_4, SC_1003_MULT_45, SC_1003_MULT_5};
-        float multiplier_factor;
+        float multiplier_factor = 0;
         const float multiplier_factors[7] = { 2.0, 2.5, 3.0, 3.5, 4.0, 4.5, 5.0};
 
         int getSampleRate(int div, float multiplierValue){
@@ -224,46 +272,46 @@ class VS1053 {
 
  public:
     // SCI Register
-    const uint8_t SCI_MODE = 0x0;
-    const uint8_t SCI_STATUS = 0x1;
-    const uint8_t SCI_BASS = 0x2;
-    const uint8_t SCI_CLOCKF = 0x3;
-    const uint8_t SCI_DECODE_TIME = 0x4;        // current decoded time in full seconds
-    const uint8_t SCI_AUDATA = 0x5;
-    const uint8_t SCI_WRAM = 0x6;
-    const uint8_t SCI_WRAMADDR = 0x7;
-    const uint8_t SCI_AIADDR = 0xA;
-    const uint8_t SCI_VOL = 0xB;
-    const uint8_t SCI_AICTRL0 = 0xC;
-    const uint8_t SCI_AICTRL1 = 0xD;
-    const uint8_t SCI_AICTRL2 = 0xE;
-    const uint8_t SCI_AICTRL3 = 0xF;
-    const uint8_t SCI_num_registers = 0xF;
+    static constexpr uint8_t SCI_MODE = 0x0;
+    static constexpr uint8_t SCI_STATUS = 0x1;
+    static constexpr uint8_t SCI_BASS = 0x2;
+    static constexpr uint8_t SCI_CLOCKF = 0x3;
+    static constexpr uint8_t SCI_DECODE_TIME = 0x4;        // current decoded time in full seconds
+    static constexpr uint8_t SCI_AUDATA = 0x5;
+    static constexpr uint8_t SCI_WRAM = 0x6;
+    static constexpr uint8_t SCI_WRAMADDR = 0x7;
+    static constexpr uint8_t SCI_AIADDR = 0xA;
+    static constexpr uint8_t SCI_VOL = 0xB;
+    static constexpr uint8_t SCI_AICTRL0 = 0xC;
+    static constexpr uint8_t SCI_AICTRL1 = 0xD;
+    static constexpr uint8_t SCI_AICTRL2 = 0xE;
+    static constexpr uint8_t SCI_AICTRL3 = 0xF;
+    static constexpr uint8_t SCI_num_registers = 0xF;
     // Stream header data
-    const uint8_t SCI_HDAT0 = 0x8;          // Stream header data 0
-    const uint8_t SCI_HDAT1 = 0x9;          // Stream header data 1
+    static constexpr uint8_t SCI_HDAT0 = 0x8;          // Stream header data 0
+    static constexpr uint8_t SCI_HDAT1 = 0x9;          // Stream header data 1
 
     // SCI_MODE bits
-    const uint8_t SM_SDINEW = 11;           // Bitnumber in SCI_MODE always on
-    const uint8_t SM_RESET = 2;             // Bitnumber in SCI_MODE soft reset
-    const uint8_t SM_CANCEL = 3;            // Bitnumber in SCI_MODE cancel song
-    const uint8_t SM_TESTS = 5;             // Bitnumber in SCI_MODE for tests
-    const uint8_t SM_LINE1 = 14;            // Bitnumber in SCI_MODE for Line input
-    const uint8_t SM_STREAM = 6;            // Bitnumber in SCI_MODE for Streaming Mode
-    const uint8_t SM_ADPCM = 12;            // Bitnumber in SCI_MODE for PCM/ADPCM recording active 
-
-    const uint16_t ADDR_REG_GPIO_DDR_RW = 0xc017;
-    const uint16_t ADDR_REG_GPIO_VAL_R = 0xc018;
-    const uint16_t ADDR_REG_GPIO_ODATA_RW = 0xc019;
-    const uint16_t ADDR_REG_I2S_CONFIG_RW = 0xc040;
+    static constexpr uint8_t SM_SDINEW = 11;           // Bitnumber in SCI_MODE always on
+    static constexpr uint8_t SM_RESET = 2;             // Bitnumber in SCI_MODE soft reset
+    static constexpr uint8_t SM_CANCEL = 3;            // Bitnumber in SCI_MODE cancel song
+    static constexpr uint8_t SM_TESTS = 5;             // Bitnumber in SCI_MODE for tests
+    static constexpr uint8_t SM_LINE1 = 14;            // Bitnumber in SCI_MODE for Line input
+    static constexpr uint8_t SM_STREAM = 6;            // Bitnumber in SCI_MODE for Streaming Mode
+    static constexpr uint8_t SM_ADPCM = 12;            // Bitnumber in SCI_MODE for PCM/ADPCM recording active 
+
+    static constexpr uint16_t ADDR_REG_GPIO_DDR_RW = 0xc017;
+    static constexpr uint16_t ADDR_REG_GPIO_VAL_R = 0xc018;
+    static constexpr uint16_t ADDR_REG_GPIO_ODATA_RW = 0xc019;
+    static constexpr uint16_t ADDR_REG_I2S_CONFIG_RW = 0xc040;
 
     // Timer settings  for VS1053 and VS1063 */
-    const uint16_t INT_ENABLE = 0xC01A;
-    const uint16_t SC_MULT_53_35X = 0x8000;
-    const uint16_t SC_ADD_53_10X = 0x0800;
+    static constexpr uint16_t INT_ENABLE = 0xC01A;
+    static constexpr uint16_t SC_MULT_53_35X = 0x8000;
+    static constexpr uint16_t SC_ADD_53_10X = 0x0800;
 
-    const uint16_t SC_EAR_SPEAKER_LO = 0x0010;
-    const uint16_t SC_EAR_SPEAKER_HI = 0x0080;
+    static constexpr uint16_t SC_EAR_SPEAKER_LO = 0x0010;
+    static constexpr uint16_t SC_EAR_SPEAKER_HI = 0x0080;
 
 
     /// Constructor which allows a custom reset pin
@@ -275,6 +323,8 @@ class VS1053 {
 
 #endif
 
+    virtual ~VS1053() = default;
+
     /// Begin operation.  Sets pins correctly, and prepares SPI bus.
     bool begin();
 
@@ -289,6 +339,18 @@ class VS1053 {
 
     /// Legacy method - Play a chunk of data.  Copies the data to the chip.  Blocks until complete
     void playChunk(uint8_t *data, size_t len);
+
+    /// Sends only the 32 byte chunks which the chip accepts without waiting for DREQ: returns the number of bytes which were accepted
+    size_t writeAudioNonBlocking(const uint8_t *data, size_t len);
+
+    /// Print compatible non blocking write: returns the number of bytes which were accepted
+    size_t write(const uint8_t *data, size_t len);
+
+    /// Print compatible non blocking write of a single byte
+    size_t write(uint8_t data);
+
+    /// Number of bytes which can be written without blocking
+    int availableForWrite();
     
     /// Finish playing a song. Call this after the last playChunk call
     void stopSong();
@@ -357,6 +419,24 @@ class VS1053 {
     /// Loads the latest generic firmware patch.
     bool loadDefaultVs1053Patches();
 
+    /// Loads the smallest patch from the VS1053PatchRegistry which supports the requested VS1053_PATCH_CAPABILITY flags
+    bool loadPatch(uint8_t capabilities);
+
+    /// Provides the patch which was loaded last (nullptr if none)
+    const VS1053Patch *loadedPatch() { return p_loaded_patch; }
+
+    /// beginOutput() does not load the patches: the patch is selected from the first bytes which are written after each startSong()
+    void setLazyPatches(bool active) { is_lazy_patches = active; }
+
+    /// Defines the clock: call before begin() or at runtime. The SPI clocks are adjusted accordingly
+    void setClock(VS1053_CLOCK clock);
+
+    /// Provides the clock setting
+    VS1053_CLOCK getClock() { return clock_setting; }
+
+    /// Determines the clock which is needed for the format of the audio data
+    static VS1053_CLOCK clockFor(const uint8_t *data, size_t len);
+
 
     /// Provides the treble amplitude value
     uint8_t treble();
@@ -388,6 +468,18 @@ class VS1053 {
 
     /// performs a MIDI command
     void sendMidiMessage(uint8_t cmd, uint8_t data1, uint8_t data2);    
+
+    /// Sends a complete MIDI message of any length (e.g. SysEx or 1 byte system messages)
+    void sendMidi(const uint8_t *msg, size_t len);
+
+    /// Collects the following MIDI messages until endMidiBatch() so that they are sent in one transaction
+    void beginMidiBatch() { is_midi_batch = true; }
+
+    /// Sends the collected MIDI messages
+    void endMidiBatch();
+
+    /// Sends the queued MIDI messages
+    void flushMidi();
 #endif
 
     /// Starts the recording of sound as WAV data
@@ -399,6 +491,27 @@ class VS1053 {
     /// Provides the audio data as WAV
     size_t readBytes(uint8_t*data, size_t len);
 
+    /// Ends the recording: the Ogg Vorbis encoder still provides the last pages via readBytes() until isInputFinished()
+    void stopInput();
+
+    /// Returns true if all recorded data has been provided after stopInput()
+    bool isInputFinished() { return is_input_finished; }
+
+    /// Provides the overrun counters and the high-water mark of the recording buffer
+    const VS1053RecordingStats &recordingStats() { return record_stats; }
+
+    /// Resets the recording counters
+    void resetRecordingStats() { record_stats = VS1053RecordingStats(); }
+
+    /// Returns true if recorded data was lost since the last resetRecordingStats()
+    bool isRecordingOverrun() { return record_stats.overruns > 0 || record_stats.invalid > 0; }
+
+    /// Time in us until the recording buffer reaches the fill target: call readBytes() then
+    uint32_t nextReadDelay();
+
+    /// Defines the fill level of the recording buffer in percent at which we should read (default 75)
+    void setReadFillTarget(uint8_t percent) { record_target_percent = percent > 100 ? 100 : percent; }
+
     /// Reads a register value
     // A low level method which lets users access the internals of the VS1053.
     uint16_t readRegister(uint8_t _reg) const;
@@ -407,6 +520,52 @@ class VS1053 {
     // A low level method which lets users access the internals of the VS1053.
     void writeRegister(uint8_t _reg, uint16_t _value) const;
 
+    /// Defines the strategy which is used to wait for DREQ when sending data (default: VS1053DreqWaitBusy). Call before begin()
+    void setDreqWait(VS1053DreqWait &wait);
+
+    /// Defines the max time in ms we wait for DREQ: 0 waits forever
+    void setDreqTimeout(uint32_t ms);
+
+    /// Defines when we wait for the completion of a register write (default: AFTER for MODE, CLOCKF, AUDATA, otherwise DEFERRED)
+    void setWriteCompletion(uint8_t reg, VS1053_COMPLETION policy);
+
+    /// Defines when we wait for the completion of a register read (default: DEFERRED for WRAM, otherwise NONE)
+    void setReadCompletion(uint8_t reg, VS1053_COMPLETION policy);
+
+    /// Runs the full SCI_VOL sweep in testComm() instead of the quick probe
+    void setFullCommTest(bool active) { is_full_comm_test = active; }
+
+    /// Defines the max time in ms we wait for the chip to get ready after a reset or clock change
+    void setReadyTimeout(uint32_t ms) { ready_timeout_ms = ms; }
+
+    /// Provides the duration of the individual steps of the last begin()
+    const VS1053StartupTiming &startupTiming() { return startup_timing; }
+
+    /// Determines the fastest working SPI clocks for the actual SCI_CLOCKF setting with a readback test of SCI_AICTRL0.
+    /// While recording only the limits of the clock are applied
+    bool calibrateSpeed();
+
+    /// Defines the SPI clocks (call after begin()): they are limited to the legal max of the actual clock
+    void setSpeedProfile(const VS1053SpeedProfile &profile);
+
+    /// Provides the SPI clocks which are used
+    const VS1053SpeedProfile &speedProfile() { return active_speed; }
+
+    /// Upper limit of the SPI clock in Hz for the calibration (e.g. because of the wiring): 0 = no limit
+    void setMaxSpeed(uint32_t hz) { max_speed = hz; }
+
+    /// begin() calibrates the SPI clocks (default true): otherwise 4 MHz is used
+    void setSpeedCalibration(bool active) { is_speed_calibration = active; }
+
+    /// Internal clock (CLKI) in Hz which is derived from SCI_CLOCKF
+    uint32_t clockFrequency() { return clki_hz; }
+
+    /// Sends the audio data in bursts sized from the estimated free FIFO space instead of 32 byte steps (for CBR streams)
+    void setBurstMode(bool active);
+
+    /// Returns true if the burst mode is active
+    bool isBurstMode() { return is_burst_mode; }
+
 
 protected:
     uint8_t cs_pin;                         // Pin where CS line is connected
@@ -416,37 +575,116 @@ protected:
     int16_t reset_pin = -1;                 // Custom Reset Pin (optional)
     int8_t  curbalance = 0;                 // Current balance setting -100..100
                                             // (-100 = right channel silent, 100 = left channel silent)
-    const uint8_t vs1053_chunk_size = 32;
+    static constexpr uint8_t vs1053_chunk_size = 32;
+    static constexpr uint32_t vs1053_xtali_hz = 12288000;
     VS1053_SPI *p_spi = nullptr;             // SPI Driver
     uint8_t endFillByte;                    // Byte to send when stopping song
     VS1053Equilizer equilizer;
     VS1053_MODE mode;
     uint16_t chip_version = -1;
     uint8_t channels_multiplier = 1;        // Repeat read values for multiple channels
-
+    uint16_t record_block_words = 1;        // Recorded data is read in blocks of n words
+    VS1053_RECORDING_FORMAT record_format = VS1053_PCM;
+    bool is_input_stopping = false;
+    bool is_input_finished = false;
+    static constexpr uint16_t record_buffer_words = 1024;  // size of the recording buffer of the chip
+    VS1053RecordingStats record_stats;
+    uint32_t record_words_per_second = 0;
+    uint32_t next_read_us = 0;
+    uint8_t record_target_percent = 75;
+    mutable VS1053DreqWaitBusy dreq_wait_busy;
+    VS1053DreqWait *p_dreq_wait = &dreq_wait_busy; // Strategy to wait for DREQ
+    uint32_t dreq_timeout_ms = 0;
+    bool is_burst_mode = false;
+    VS1053FifoModel fifo_model;
+    VS1053_COMPLETION sci_read_completion[16];
+    VS1053_COMPLETION sci_write_completion[16];
+    mutable bool is_sci_pending = false;    // deferred completion of the last SCI operation
+    bool is_full_comm_test = false;
+    bool is_lazy_patches = false;
+    bool is_patch_pending = false;
+    VS1053_CLOCK clock_setting = VS1053_CLOCK_30X;
+    bool is_clock_pending = false;
+    bool is_started = false;
+#if USE_MIDI
+    VS1053MidiQueue midi_queue;
+    bool is_midi_batch = false;
+#endif
+    const VS1053Patch *p_loaded_patch = nullptr;
+    uint32_t ready_timeout_ms = 100;
+    VS1053StartupTiming startup_timing;
+    VS1053SpeedProfile speed_profile;       // requested SPI clocks
+    mutable VS1053SpeedProfile active_speed; // SPI clocks limited by the actual CLKI
+    mutable uint32_t clki_hz = vs1053_xtali_hz;
+    uint32_t max_speed = 0;
+    bool is_speed_calibration = true;
+    mutable VS1053Mutex mutex;              // serializes the public methods which access the chip
 
 
 protected:
 
-    inline void await_data_request() const {
-        while (!digitalRead(dreq_pin)) {
-            yield();                        // Very short delay
+    /// SDI waits are using the configured strategy, the short SCI waits are polling
+    inline void await_data_request(bool is_sdi = false) const {
+        VS1053DreqWait *p_wait = is_sdi ? p_dreq_wait : &dreq_wait_busy;
+        if (!p_wait->await(dreq_timeout_ms)) {
+            VS1053_LOGW("DREQ timeout");
+        }
+    }
+
+    /// Waits for a deferred SCI completion
+    inline void await_sci_completion() const {
+        if (is_sci_pending) {
+            is_sci_pending = false;
+            await_data_request();
+        }
+    }
+
+    /// Waits for the completion of a SCI operation according to the policy
+    inline void complete_sci(VS1053_COMPLETION policy) const {
+        switch (policy) {
+            case VS1053_COMPLETION_AFTER:
+                await_data_request();
+                break;
+            case VS1053_COMPLETION_DEFERRED:
+                is_sci_pending = true;
+                break;
+            default:
+                break;
         }
     }
 
-    inline void control_mode_on() const {
-        p_spi->beginTransaction();   // Prevent other SPI users
+    /// Determines CLKI from the SCI_CLOCKF value and limits the SPI clocks
+    void update_clock(uint16_t clockf) const;
+
+    /// Limits the requested SPI clocks to the legal max of CLKI
+    void update_speeds() const;
+
+    /// Reads are slower then writes: a session with writes only can use the write speed
+    inline void control_mode_on(bool is_write_only = false) const {
+        // Prevent other SPI users: the speed is only changed when we own the bus
+        p_spi->beginTransaction(is_write_only ? active_speed.sci_write : active_speed.sci_read);
         digitalWrite(dcs_pin, HIGH);        // Bring slave in control mode
-        digitalWrite(cs_pin, LOW);
     }
 
     inline void control_mode_off() const {
-        digitalWrite(cs_pin, HIGH);         // End control mode
         p_spi->endTransaction();               // Allow other SPI users
     }
 
+    /// Reads a register in control mode: xCS is only active for this operation
+    uint16_t sci_read(uint8_t reg) const;
+
+    /// Writes a register in control mode: xCS is only active for this operation
+    void sci_write(uint8_t reg, uint16_t value) const;
+
+    /// Reads the same register n times: the completion policy is only applied at the end
+    void sci_read_multiple(uint8_t reg, uint16_t *data, size_t n) const;
+
+    /// SCI multiple write: sends n words (or n times the first word) to the same register while xCS stays low
+    void sci_write_multiple(uint8_t reg, const uint16_t *data, size_t n, bool repeat) const;
+
     inline void data_mode_on() const {
-        p_spi->beginTransaction();   // Prevent other SPI users
+        p_spi->beginTransaction(active_speed.sdi);   // Prevent other SPI users
+        await_sci_completion();      // SDI must not start before the last SCI operation has completed
         digitalWrite(cs_pin, HIGH);         // Bring slave in data mode
         digitalWrite(dcs_pin, LOW);
     }
@@ -456,10 +694,26 @@ protected:
         p_spi->endTransaction();               // Allow other SPI users
     }
 
+    /// Sends the audio data of writeAudio(): subclasses (e.g. VS1053Static) can provide a faster data path
+    virtual void sdi_write_audio(uint8_t *data, size_t len);
+
     void sdi_send_buffer(uint8_t *data, size_t len);
 
     void sdi_send_fillers(size_t length);
 
+    void sdi_send_midi(const uint8_t *data, size_t len);
+
+    template <class F>
+    void sdi_send_double_buffered(size_t len, F fill);
+
+    void sdi_write_chunk(const uint8_t *data, size_t len);
+
+    size_t sdi_burst_size();
+
+    size_t sdi_next_size();
+
+    void fifo_sent(size_t len);
+
     void wram_write(uint16_t address, uint16_t data);
 
     uint16_t wram_read(uint16_t address);
@@ -468,7 +722,79 @@ protected:
 
     bool begin_input_vs1003(VS1053Recording &opt);
 
+    bool begin_input_ogg(VS1053Recording &opt);
+
+    size_t record_words(size_t words);
+
+    void schedule_read(size_t remaining_words, uint32_t time_us);
+
     void set_flag(uint16_t &value, uint16_t flag, bool active);
+
+    void setup_completion();
+
+    bool test_comm_value(uint16_t value);
+
+    /// Quick readback test of the register with the actual speed profile
+    bool test_speed(uint8_t reg);
+
+    /// Probes the SPI clocks upwards with readback tests of the register: the value is restored at the end
+    bool calibrate_speed(uint8_t reg);
+
+    void load_patch_for(const uint8_t *data, size_t len);
+
+    /// Writes SCI_CLOCKF and adjusts the SPI clocks
+    void apply_clock(uint16_t clockf);
+
+    /// VS1053_CLOCK_AUTO: selects the clock from the first bytes of the song
+    void apply_clock_for(const uint8_t *data, size_t len);
+
+    /// Waits until DREQ is high: returns false after the ready timeout
+    bool await_ready();
+};
+
+/**
+ * @brief Scoped SCI session: holds the SPI bus for a sequence of register operations,
+ * so that the transaction is started only once. xCS is still raised after each
+ * operation as required by the SCI protocol. Do not call any other VS1053 methods
+ * and avoid delays while the session is open.
+ */
+class VS1053SciSession {
+  public:
+    /// Sessions with write operations only can use the faster SCI write speed
+    VS1053SciSession(const VS1053 &vs1053, bool isWriteOnly = false) : vs(vs1053) { vs.control_mode_on(isWriteOnly); }
+    VS1053SciSession(const VS1053SciSession &) = delete;
+    VS1053SciSession &operator=(const VS1053SciSession &) = delete;
+    ~VS1053SciSession() { vs.control_mode_off(); }
+
+    /// Reads a register value
+    uint16_t read(uint8_t reg) { return vs.sci_read(reg); }
+
+    /// Writes a register value
+    void write(uint8_t reg, uint16_t value) { vs.sci_write(reg, value); }
+
+    /// Reads the same register n times (e.g. SCI_HDAT0 for recording)
+    void readMultiple(uint8_t reg, uint16_t *data, size_t n) { vs.sci_read_multiple(reg, data, n); }
+
+    /// Writes n words to the same register w/o raising xCS (SCI multiple write: VS1053 only)
+    void writeMultiple(uint8_t reg, const uint16_t *data, size_t n) { vs.sci_write_multiple(reg, data, n, false); }
+
+    /// Writes the same value n times to the register w/o raising xCS (SCI multiple write: VS1053 only)
+    void writeRepeat(uint8_t reg, uint16_t value, size_t n) { vs.sci_write_multiple(reg, &value, n, true); }
+
+    /// Writes a value to the WRAM
+    void wramWrite(uint16_t address, uint16_t value) {
+        write(vs.SCI_WRAMADDR, address);
+        write(vs.SCI_WRAM, value);
+    }
+
+    /// Reads a value from the WRAM
+    uint16_t wramRead(uint16_t address) {
+        write(vs.SCI_WRAMADDR, address);
+        return read(vs.SCI_WRAM);
+    }
+
+  protected:
+    const VS1053 &vs;
 };
 
 }
@@ -0,0 +1,110 @@
+#ifndef ARDUINO
+#include "VS1053Ext.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace arduino_vs1053 {
+
+VS1053ConsolePrint VS1053Console;
+
+/**
+ * @brief Default pin hooks: we use the system clock and keep the pin
+ * values in a table. Unknown pins report HIGH so that DREQ does not block.
+ * A rising edge written to a pin with an attached interrupt calls the isr and
+ * wakes up the threads in waitForInterrupt().
+ */
+class VS1053DefaultPinHooks : public VS1053PinHooks {
+  public:
+    VS1053DefaultPinHooks() {
+        memset(pins, HIGH, sizeof(pins));
+    }
+
+    void delay(uint32_t ms) override {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+
+    void yield() override {
+        std::this_thread::yield();
+    }
+
+    void digitalWrite(uint8_t pin, uint8_t value) override {
+        bool rising = pins[pin] == LOW && value != LOW;
+        pins[pin] = value;
+        if (rising && isrs[pin] != nullptr) {
+            isrs[pin](isr_args[pin]);
+            std::lock_guard<std::mutex> lock(mtx);
+            interrupt_count++;
+            cond.notify_all();
+        }
+    }
+
+    int digitalRead(uint8_t pin) override {
+        return pins[pin];
+    }
+
+    void pinMode(uint8_t /*pin*/, uint8_t /*mode*/) override {}
+
+    unsigned long millis() override {
+        return micros() / 1000;
+    }
+
+    unsigned long micros() override {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - start)
+            .count();
+    }
+
+    void attachInterrupt(uint8_t pin, void (*isr)(void *), void *arg) override {
+        isr_args[pin] = arg;
+        isrs[pin] = isr;
+    }
+
+    void detachInterrupt(uint8_t pin) override {
+        isrs[pin] = nullptr;
+    }
+
+    bool waitForInterrupt(uint32_t timeout_us) override {
+        std::unique_lock<std::mutex> lock(mtx);
+        uint32_t count = interrupt_count;
+        return cond.wait_for(lock, std::chrono::microseconds(timeout_us),
+                             [&] { return interrupt_count != count; });
+    }
+
+  protected:
+    uint8_t pins[256];
+    void (*isrs[256])(void *) = {};
+    void *isr_args[256] = {};
+    std::mutex mtx;
+    std::condition_variable cond;
+    uint32_t interrupt_count = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+};
+
+static VS1053DefaultPinHooks default_pin_hooks;
+static VS1053PinHooks *p_pin_hooks = &default_pin_hooks;
+
+void setPinHooks(VS1053PinHooks *hooks) {
+    p_pin_hooks = hooks == nullptr ? &default_pin_hooks : hooks;
+}
+
+VS1053PinHooks &pinHooks() { return *p_pin_hooks; }
+
+void delay(int ms) { p_pin_hooks->delay(ms); }
+
+void yield() { p_pin_hooks->yield(); }
+
+void digitalWrite(uint8_t pin, uint8_t value) { p_pin_hooks->digitalWrite(pin, value); }
+
+int digitalRead(uint8_t pin) { return p_pin_hooks->digitalRead(pin); }
+
+void pinMode(uint8_t pin, uint8_t mode) { p_pin_hooks->pinMode(pin, mode); }
+
+unsigned long millis() { return p_pin_hooks->millis(); }
+
+unsigned long micros() { return p_pin_hooks->micros(); }
+
+}
+
+#endif
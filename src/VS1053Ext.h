@@ -1,16 +1,11 @@
 #pragma once
 #ifndef ARDUINO
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#ifndef min
-# define min(a,b) a<b?a:b
-#endif
-
-#ifndef may
-# define max(a,b) a>b?a:b
-#endif
-
 #ifndef HIGH
 # define HIGH 1
 #endif
@@ -31,18 +26,154 @@
 
 namespace arduino_vs1053 {
 
-// If you want to use the project outside of Arduino you need to implement the following 
-// methods:
+// We use functions instead of macros so that the standard headers stay usable
+template <class T> inline T min(T a, T b) { return a < b ? a : b; }
+template <class T> inline T max(T a, T b) { return a > b ? a : b; }
+
+/**
+ * @brief Minimal replacement for the Arduino Print class which is used
+ * outside of Arduino
+ */
+class Print {
+  public:
+    virtual ~Print() = default;
+
+    virtual size_t write(uint8_t ch) = 0;
+
+    virtual size_t write(const uint8_t *data, size_t len) {
+        size_t result = 0;
+        for (size_t j = 0; j < len; j++) {
+            result += write(data[j]);
+        }
+        return result;
+    }
+
+    size_t print(const char *str) {
+        return write((const uint8_t *)str, strlen(str));
+    }
+
+    size_t println(const char *str) {
+        size_t result = print(str);
+        return result + write('\n');
+    }
+};
+
+/**
+ * @brief Print implementation which is writing to stdout
+ */
+class VS1053ConsolePrint : public Print {
+  public:
+    using Print::write;
+    size_t write(uint8_t ch) override {
+        return fputc(ch, stdout) == EOF ? 0 : 1;
+    }
+    size_t write(const uint8_t *data, size_t len) override {
+        return fwrite(data, 1, len, stdout);
+    }
+};
+
+extern VS1053ConsolePrint VS1053Console;
+
+/**
+ * @brief Minimal replacement for the Arduino Stream class which is used
+ * outside of Arduino
+ */
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    virtual size_t readBytes(uint8_t *data, size_t len) {
+        size_t result = 0;
+        while (result < len) {
+            int ch = read();
+            if (ch < 0) break;
+            data[result++] = ch;
+        }
+        return result;
+    }
+};
+
+/**
+ * @brief Stream which reads from and writes to a FILE
+ */
+class VS1053FileStream : public Stream {
+  public:
+    VS1053FileStream(FILE *file) : file(file) {}
 
+    using Print::write;
+    size_t write(uint8_t ch) override { return fputc(ch, file) == EOF ? 0 : 1; }
+    size_t write(const uint8_t *data, size_t len) override { return fwrite(data, 1, len, file); }
+
+    int available() override {
+        long pos = ftell(file);
+        if (pos < 0 || fseek(file, 0, SEEK_END) != 0) return 0;
+        long end = ftell(file);
+        fseek(file, pos, SEEK_SET);
+        return end > pos ? static_cast<int>(end - pos) : 0;
+    }
+
+    int read() override { return fgetc(file); }
+
+    int peek() override {
+        int ch = fgetc(file);
+        if (ch != EOF) ungetc(ch, file);
+        return ch;
+    }
+
+    size_t readBytes(uint8_t *data, size_t len) override { return fread(data, 1, len, file); }
+
+    using Stream::read;
+    size_t read(uint8_t *data, size_t len) { return fread(data, 1, len, file); }
+
+    bool seek(uint32_t pos) { return fseek(file, pos, SEEK_SET) == 0; }
+
+  protected:
+    FILE *file;
+};
+
+/**
+ * @brief If you want to use the project outside of Arduino you can provide the
+ * pin and timing functions by implementing this class and registering it
+ * with setPinHooks(). By default we use the system clock and a pin state table.
+ */
+class VS1053PinHooks {
+  public:
+    virtual ~VS1053PinHooks() = default;
+    virtual void delay(uint32_t ms) = 0;
+    virtual void yield() = 0;
+    virtual void digitalWrite(uint8_t pin, uint8_t value) = 0;
+    virtual int digitalRead(uint8_t pin) = 0;
+    virtual void pinMode(uint8_t pin, uint8_t mode) = 0;
+    virtual unsigned long millis() = 0;
+    virtual unsigned long micros() = 0;
+    /// Calls the isr with the arg on a rising edge of the pin
+    virtual void attachInterrupt(uint8_t pin, void (*isr)(void *), void *arg) = 0;
+    virtual void detachInterrupt(uint8_t pin) = 0;
+    /// Suspends the caller until an interrupt was raised or the timeout has passed
+    virtual bool waitForInterrupt(uint32_t timeout_us) = 0;
+};
+
+/// Defines the active pin hooks: use nullptr to restore the default implementation
+void setPinHooks(VS1053PinHooks *hooks);
+
+/// Provides the active pin hooks
+VS1053PinHooks &pinHooks();
+
+// Arduino API which is forwarded to the active pin hooks
 void delay(int);
 void yield();
 void digitalWrite(uint8_t, uint8_t);
 int digitalRead(uint8_t);
 void pinMode(uint8_t, uint8_t);
-long map(long x, long in_min, long in_max, long out_min, long out_max) {
+unsigned long millis();
+unsigned long micros();
+
+inline long map(long x, long in_min, long in_max, long out_min, long out_max) {
   return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
 }
 
 }
 
-#endif
\ No newline at end of file
+#endif
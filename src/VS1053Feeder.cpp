@@ -0,0 +1,83 @@
+#include "VS1053Feeder.h"
+#if USE_TASKS
+
+namespace arduino_vs1053 {
+
+bool VS1053Feeder::begin(size_t bufferSize) {
+    end();
+    if (!buffer.begin(bufferSize)) {
+        VS1053_LOGE("Not enough memory for feeder buffer");
+        return false;
+    }
+    underrun_count = 0;
+    is_active = true;
+#ifdef ARDUINO_ARCH_ESP32
+    is_task_running = true;
+    BaseType_t rc = task_core < 0
+                        ? xTaskCreate(task, "vs1053-feeder", task_stack_size, this, task_priority, &task_handle)
+                        : xTaskCreatePinnedToCore(task, "vs1053-feeder", task_stack_size, this, task_priority,
+                                                  &task_handle, task_core);
+    if (rc != pdPASS) {
+        VS1053_LOGE("Could not start feeder task");
+        is_active = false;
+        is_task_running = false;
+        return false;
+    }
+#else
+    thread = std::thread(task, this);
+#endif
+    return true;
+}
+
+void VS1053Feeder::end() {
+    if (is_active) {
+        is_active = false;
+#ifdef ARDUINO_ARCH_ESP32
+        while (is_task_running) delay(1);
+#else
+        if (thread.joinable()) thread.join();
+#endif
+    }
+    buffer.end();
+}
+
+void VS1053Feeder::flush() {
+    while (is_active && (buffer.available() > 0 || is_sending)) {
+        delay(1);
+    }
+}
+
+void VS1053Feeder::task(void *arg) {
+    VS1053Feeder *self = static_cast<VS1053Feeder *>(arg);
+    self->pump();
+#ifdef ARDUINO_ARCH_ESP32
+    self->is_task_running = false;
+    vTaskDelete(nullptr);
+#endif
+}
+
+/// Consumer: sends the buffered data to the VS1053 until end() is called
+void VS1053Feeder::pump() {
+    bool is_empty = true;
+    while (is_active) {
+        const uint8_t *data;
+        size_t len = buffer.peek(&data);
+        if (len == 0) {
+            if (!is_empty) underrun_count++;
+            is_empty = true;
+            is_sending = false;
+            delay(1);
+            continue;
+        }
+        is_empty = false;
+        is_sending = true;
+        if (len > max_chunk_size) len = max_chunk_size;
+        vs.writeAudio(const_cast<uint8_t *>(data), len);
+        buffer.consume(len);
+    }
+    is_sending = false;
+}
+
+}
+
+#endif
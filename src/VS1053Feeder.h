@@ -0,0 +1,80 @@
+#pragma once
+#include "VS1053Config.h"
+#if USE_TASKS
+#include "VS1053Driver.h"
+#include "VS1053RingBuffer.h"
+#ifndef ARDUINO
+#include <thread>
+#endif
+
+namespace arduino_vs1053 {
+
+/**
+ * @brief Background feeder: the producer writes the audio data into a lock-free
+ * ring buffer and a background task (FreeRTOS task on the ESP32, std::thread outside
+ * of Arduino) sends it to the VS1053. So the producer never needs to wait for
+ * DREQ or SPI.
+ * @author pschatzmann
+ */
+class VS1053Feeder {
+  public:
+    VS1053Feeder(VS1053 &vs1053) : vs(vs1053) {}
+    ~VS1053Feeder() { end(); }
+
+    /// Allocates the ring buffer and starts the background task
+    bool begin(size_t bufferSize = 16 * 1024);
+
+    /// Stops the background task and releases the buffer
+    void end();
+
+    /// Producer: adds the data to the buffer (without blocking) and returns the number of accepted bytes
+    size_t write(const uint8_t *data, size_t len) { return buffer.write(data, len); }
+
+    /// Number of bytes which can be written without blocking
+    size_t availableForWrite() { return buffer.availableForWrite(); }
+
+    /// Number of bytes which have not been sent to the VS1053 yet
+    size_t available() { return buffer.available(); }
+
+    /// Blocks until the buffer has been sent to the VS1053
+    void flush();
+
+    /// Number of times the buffer ran empty while the feeder was active
+    uint32_t underruns() { return underrun_count; }
+
+    /// Max number of bytes which are sent in one writeAudio() call
+    void setMaxChunkSize(size_t size) { max_chunk_size = size; }
+
+#ifdef ARDUINO_ARCH_ESP32
+    /// Defines the FreeRTOS task priority, stack size and core (-1 for any core): call before begin()
+    void setTaskConfig(UBaseType_t priority, uint32_t stackSize = 4096, int core = -1) {
+        task_priority = priority;
+        task_stack_size = stackSize;
+        task_core = core;
+    }
+#endif
+
+  protected:
+    VS1053 &vs;
+    VS1053RingBuffer buffer;
+    std::atomic<bool> is_active{false};
+    std::atomic<bool> is_sending{false};
+    std::atomic<uint32_t> underrun_count{0};
+    size_t max_chunk_size = 512;
+#ifdef ARDUINO_ARCH_ESP32
+    TaskHandle_t task_handle = nullptr;
+    std::atomic<bool> is_task_running{false};
+    UBaseType_t task_priority = 2;
+    uint32_t task_stack_size = 4096;
+    int task_core = -1;
+#else
+    std::thread thread;
+#endif
+
+    void pump();
+    static void task(void *arg);
+};
+
+}
+
+#endif
@@ -0,0 +1,112 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+namespace arduino_vs1053 {
+
+/**
+ * @brief Conservative model of the fill level of the decoder's stream buffer (FIFO)
+ * with integer math only. We track an upper bound of the fill level: the FIFO is
+ * empty after a reset, DREQ high means that there is space for at least 32 bytes and
+ * a rising edge of DREQ means that the fill level is just below the capacity - 32. The
+ * consumption rate is learned from the bytes which were sent between two rising edges,
+ * which are at the same fill level. As long as the rate is unknown free() only reports
+ * the space which is guaranteed by DREQ, so that the caller uses the 32 byte DREQ stepping.
+ * @author pschatzmann
+ */
+class VS1053FifoModel {
+  public:
+    /// Defines the size of the FIFO in bytes
+    void setCapacity(size_t size) { capacity = size; }
+
+    /// The FIFO is empty (e.g. after a reset): we do not know the consumption rate yet
+    void reset() {
+        fill = 0;
+        rate = 0;
+        has_ref = false;
+    }
+
+    /// The FIFO state is unknown
+    void clear() {
+        reset();
+        fill = capacity;
+    }
+
+    /// DREQ was low: the FIFO is full
+    void full(uint32_t now_us) {
+        update(now_us);
+        if (capacity - fill >= 2 * chunk) {
+            // we expected free space: the decoder got slower, so we measure again
+            rate = 0;
+            has_ref = false;
+        }
+        fill = capacity;
+    }
+
+    /// DREQ is high: there is space for at least 32 bytes
+    void ready(uint32_t now_us) {
+        update(now_us);
+        if (fill > capacity - chunk) fill = capacity - chunk;
+    }
+
+    /// DREQ went high while we were waiting: the fill level is (just below) capacity - 32
+    void rising(uint32_t now_us) {
+        ready(now_us);
+        if (has_ref && now_us - ref_time_us < measure_period_us) return;
+        if (has_ref) {
+            // the fill level is the same at both edges: so the decoder consumed what we have sent
+            uint32_t measured = ((uint64_t)(total_bytes - ref_bytes) << 16) / (now_us - ref_time_us);
+            // we assume a slower consumption than measured (e.g. VBR)
+            measured -= measured / 8;
+            // max 1 byte per us, so that update() does not overflow
+            if (measured > 0xFFFF) measured = 0xFFFF;
+            // a slower decoder must be taken into account immediately
+            rate = rate == 0 || measured < rate ? measured : (3 * rate + measured) / 4;
+        }
+        has_ref = true;
+        ref_time_us = now_us;
+        ref_bytes = total_bytes;
+    }
+
+    /// Data was sent to the FIFO
+    void sent(size_t bytes, uint32_t now_us) {
+        update(now_us);
+        fill = fill + bytes > capacity ? capacity : fill + bytes;
+        total_bytes += bytes;
+    }
+
+    /// Conservative estimate of the free space in bytes (multiple of 32)
+    size_t free(uint32_t now_us) {
+        update(now_us);
+        return (capacity - fill) & ~static_cast<size_t>(chunk - 1);
+    }
+
+    /// Estimated consumption rate in bytes per second (0 if unknown)
+    uint32_t bytesPerSecond() { return ((uint64_t)rate * 1000000ul) >> 16; }
+
+  protected:
+    static const uint32_t chunk = 32;
+    static const uint32_t measure_period_us = 250000;
+    uint32_t capacity = 2048;
+    bool has_ref = false;
+    uint32_t fill = 2048;       // upper bound of the fill level in bytes
+    uint32_t rate = 0;          // consumed bytes per us with 16 fractional bits
+    uint32_t time_us = 0;
+    uint32_t ref_time_us = 0;
+    uint32_t total_bytes = 0;
+    uint32_t ref_bytes = 0;
+
+    /// Subtracts the bytes which were consumed since the last update: steps of max 65 ms avoid an overflow
+    void update(uint32_t now_us) {
+        uint32_t elapsed = now_us - time_us;
+        time_us = now_us;
+        while (elapsed > 0 && fill > 0 && rate > 0) {
+            uint32_t step = elapsed > 0xFFFF ? 0xFFFF : elapsed;
+            uint32_t consumed = (rate * step) >> 16;
+            fill = consumed < fill ? fill - consumed : 0;
+            elapsed -= step;
+        }
+    }
+};
+
+}
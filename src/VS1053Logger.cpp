@@ -4,4 +4,168 @@ namespace arduino_vs1053 {
 
 VS1053LoggerClass VS1053Logger;
 
-}
\ No newline at end of file
+#if USE_TASKS
+
+/// Call when no other task is logging: the queued messages are printed when the deferred mode is stopped
+bool VS1053LoggerClass::setDeferred(bool active) {
+  if (active == isDeferred()) return true;
+  if (active) {
+    p_queue = new (std::nothrow) VS1053LogQueue();
+    return p_queue != nullptr;
+  }
+  process();
+  delete p_queue;
+  p_queue = nullptr;
+  return true;
+}
+
+size_t VS1053LoggerClass::process() {
+  if (p_queue == nullptr) return 0;
+  size_t result = 0;
+  VS1053LogEntry entry;
+  while (p_queue->pop(entry)) {
+    char log_buffer[LOG_BUFFER_SIZE];
+    size_t off = prefix(entry.level, log_buffer);
+    if (off < LOG_BUFFER_SIZE) {
+      format(entry, log_buffer + off, LOG_BUFFER_SIZE - off);
+    }
+    p_out->println(log_buffer);
+    result++;
+  }
+  return result;
+}
+
+void VS1053LoggerClass::store_arg(VS1053LogEntry &entry, const char *value) {
+  VS1053LogArg &arg = entry.args[entry.count];
+  size_t avail = sizeof(entry.text) - entry.text_len;
+  if (value == nullptr) {
+    arg.p = nullptr;
+  } else if (avail == 0) {
+    // no space left for the copy
+    arg.p = "...";
+  } else {
+    size_t len = strlen(value);
+    if (len > avail - 1) len = avail - 1;
+    memcpy(entry.text + entry.text_len, value, len);
+    entry.text[entry.text_len + len] = 0;
+    arg.u = entry.text_len;
+    entry.text_mask |= 1 << entry.count;
+    entry.text_len += len + 1;
+  }
+  entry.count++;
+}
+
+/// printf with the stored arguments: each conversion is formatted individually with the type
+/// which is defined by its length modifier
+void VS1053LoggerClass::format(const VS1053LogEntry &entry, char *out, size_t size) {
+  size_t len = 0;
+  uint8_t arg_idx = 0;
+  const char *fmt = entry.fmt;
+  out[0] = 0;
+  while (*fmt && len + 1 < size) {
+    if (*fmt != '%' || fmt[1] == '%') {
+      out[len++] = *fmt;
+      fmt += *fmt == '%' ? 2 : 1;
+      out[len] = 0;
+      continue;
+    }
+    // %[flags][width][.precision][length]conversion
+    char spec[16];
+    size_t spec_len = 0;
+    spec[spec_len++] = *fmt++;
+    while (*fmt && strchr("-+ #0123456789.", *fmt) && spec_len < sizeof(spec) - 4) {
+      spec[spec_len++] = *fmt++;
+    }
+    char length[3] = {0, 0, 0};
+    size_t length_len = 0;
+    while (*fmt && strchr("hlLzjt", *fmt)) {
+      if (length_len < 2) length[length_len++] = *fmt;
+      fmt++;
+    }
+    char conversion = *fmt;
+    if (conversion == 0) break;
+    fmt++;
+    VS1053LogArg arg;
+    arg.u = 0;
+    bool is_text = false;
+    if (arg_idx < entry.count) {
+      is_text = entry.text_mask & (1 << arg_idx);
+      arg = entry.args[arg_idx++];
+    }
+    // the copied strings are stored as offset
+    if (is_text) arg.p = entry.text + arg.u;
+
+    int n = 0;
+    char *dest = out + len;
+    size_t avail = size - len;
+    switch (conversion) {
+      case 'd':
+      case 'i': {
+        long long value;
+        if (strcmp(length, "ll") == 0 || strcmp(length, "j") == 0) value = (long long)arg.u;
+        else if (strcmp(length, "l") == 0 || strcmp(length, "z") == 0 || strcmp(length, "t") == 0) value = (long)arg.u;
+        else if (strcmp(length, "hh") == 0) value = (signed char)arg.u;
+        else if (strcmp(length, "h") == 0) value = (short)arg.u;
+        else value = (int)arg.u;
+        memcpy(spec + spec_len, "ll", 2);
+        spec[spec_len + 2] = conversion;
+        spec[spec_len + 3] = 0;
+        n = snprintf(dest, avail, spec, value);
+      } break;
+      case 'u':
+      case 'x':
+      case 'X':
+      case 'o': {
+        unsigned long long value;
+        if (strcmp(length, "ll") == 0 || strcmp(length, "j") == 0) value = arg.u;
+        else if (strcmp(length, "l") == 0 || strcmp(length, "z") == 0 || strcmp(length, "t") == 0) value = (unsigned long)arg.u;
+        else if (strcmp(length, "hh") == 0) value = (unsigned char)arg.u;
+        else if (strcmp(length, "h") == 0) value = (unsigned short)arg.u;
+        else value = (unsigned)arg.u;
+        memcpy(spec + spec_len, "ll", 2);
+        spec[spec_len + 2] = conversion;
+        spec[spec_len + 3] = 0;
+        n = snprintf(dest, avail, spec, value);
+      } break;
+      case 'c':
+        spec[spec_len++] = conversion;
+        spec[spec_len] = 0;
+        n = snprintf(dest, avail, spec, (int)arg.u);
+        break;
+      case 'f':
+      case 'F':
+      case 'e':
+      case 'E':
+      case 'g':
+      case 'G':
+      case 'a':
+      case 'A':
+        spec[spec_len++] = conversion;
+        spec[spec_len] = 0;
+        n = snprintf(dest, avail, spec, arg.d);
+        break;
+      case 's':
+        spec[spec_len++] = conversion;
+        spec[spec_len] = 0;
+        n = snprintf(dest, avail, spec, arg.p == nullptr ? "(null)" : (const char *)arg.p);
+        break;
+      case 'p':
+        spec[spec_len++] = conversion;
+        spec[spec_len] = 0;
+        n = snprintf(dest, avail, spec, arg.p);
+        break;
+      default:
+        // unsupported conversion: we output it unchanged
+        spec[spec_len++] = conversion;
+        spec[spec_len] = 0;
+        n = snprintf(dest, avail, "%s", spec);
+        break;
+    }
+    if (n < 0) break;
+    len += (size_t)n < avail ? (size_t)n : avail - 1;
+  }
+}
+
+#endif
+
+}
@@ -1,19 +1,108 @@
 #pragma once
 
-#pragma once
+#ifdef ARDUINO
 #include "Arduino.h"
+#else
+#include "VS1053Ext.h"
+#endif
 #include "VS1053Config.h"
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
+#if USE_TASKS
+#include <atomic>
+#include <new>
+#include <type_traits>
+#endif
 
 namespace arduino_vs1053 {
 
 enum VS1053LogLevel_t { VS1053Debug, VS1053Info, VS1053Warning, VS1053Error };
 
+#if USE_TASKS
+
+/// Argument of a deferred log message
+union VS1053LogArg {
+  unsigned long long u;
+  double d;
+  const void *p;
+};
+
+/// Log message which is formatted later: the strings are copied to text
+struct VS1053LogEntry {
+  static const uint8_t max_args = 6;
+  const char *fmt;
+  uint8_t level;
+  uint8_t count;
+  uint8_t text_mask;  // bit n: args[n] is an offset in text
+  uint8_t text_len;
+  VS1053LogArg args[max_args];
+  char text[VS1053_LOG_TEXT_SIZE];
+};
+static_assert(VS1053_LOG_TEXT_SIZE < 256, "VS1053_LOG_TEXT_SIZE must be below 256");
+
+/**
+ * @brief Lock-free bounded multiple producer / single consumer queue for the deferred
+ * log messages: each slot has a sequence number which tells if it can be written
+ * or read, so any task can add messages without locking.
+ * @author pschatzmann
+ */
+class VS1053LogQueue {
+public:
+  VS1053LogQueue() {
+    for (size_t j = 0; j < capacity; j++) slots[j].seq.store(j, std::memory_order_relaxed);
+  }
+
+  /// Producer: returns false if the queue is full
+  template <typename F>
+  bool push(F fill) {
+    size_t pos = write_pos.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+      slot = &slots[pos & mask];
+      size_t seq = slot->seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0) {
+        if (write_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = write_pos.load(std::memory_order_relaxed);
+      }
+    }
+    fill(slot->entry);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Consumer: returns false if the queue is empty
+  bool pop(VS1053LogEntry &entry) {
+    Slot &slot = slots[read_pos & mask];
+    if (slot.seq.load(std::memory_order_acquire) != read_pos + 1) return false;
+    entry = slot.entry;
+    slot.seq.store(read_pos + capacity, std::memory_order_release);
+    read_pos++;
+    return true;
+  }
+
+protected:
+  static const size_t capacity = VS1053_LOG_QUEUE_SIZE;
+  static const size_t mask = capacity - 1;
+  static_assert((capacity & mask) == 0, "VS1053_LOG_QUEUE_SIZE must be a power of 2");
+  struct Slot {
+    std::atomic<size_t> seq;
+    VS1053LogEntry entry;
+  };
+  Slot slots[capacity];
+  std::atomic<size_t> write_pos{0};
+  size_t read_pos = 0;
+};
+
+#endif
+
 /**
  * @brief Logging class which supports multiple log levels
- * 
+ *
  */
 class VS1053LoggerClass {
 public:
@@ -27,16 +116,16 @@ public:
     return true;
   }
 
+  /// Checks if messages of the indicated level are logged
+  bool isLogging(VS1053LogLevel_t level) { return logLevel <= level; }
+
   /// Print log message
   void log(VS1053LogLevel_t level, const char *fmt...) {
     if (logLevel <= level) { // AUDIOKIT_LOG_LEVEL = Debug
       char log_buffer[LOG_BUFFER_SIZE];
-      strcpy(log_buffer,"VS1053 - ");  
-      strcat(log_buffer, VS1053_log_msg[level]);
-      strcat(log_buffer, ":     ");
+      size_t off = prefix(level, log_buffer);
       va_list arg;
       va_start(arg, fmt);
-      size_t off = strlen(log_buffer);
       if (off < LOG_BUFFER_SIZE) {
         vsnprintf(log_buffer + off, LOG_BUFFER_SIZE - off, fmt, arg);
       }
@@ -45,17 +134,137 @@ public:
     }
   }
 
+#if USE_TASKS
+
+  /// Deferred mode: the messages are only queued and printed by process(). Strings are copied (max VS1053_LOG_TEXT_SIZE bytes per message)
+  bool setDeferred(bool active);
+
+  /// Checks if the deferred mode is active
+  bool isDeferred() { return p_queue != nullptr; }
+
+  /// Formats and prints the queued messages: call from a low priority context (e.g. the loop)
+  size_t process();
+
+  /// Number of messages which were lost because the queue was full
+  uint32_t dropped() { return dropped_count.load(std::memory_order_relaxed); }
+
+  /// Queues the message in the deferred mode, otherwise it is printed
+  template <typename... Args>
+  void logArgs(VS1053LogLevel_t level, const char *fmt, Args... args) {
+    if (p_queue == nullptr) {
+      log(level, fmt, args...);
+      return;
+    }
+    static_assert(sizeof...(Args) <= VS1053LogEntry::max_args, "Too many log arguments");
+    bool ok = p_queue->push([&](VS1053LogEntry &entry) {
+      entry.fmt = fmt;
+      entry.level = level;
+      entry.count = 0;
+      entry.text_mask = 0;
+      entry.text_len = 0;
+      store_args(entry, args...);
+    });
+    if (!ok) dropped_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+#endif
+
 protected:
   // Error level as string
   const char *VS1053_log_msg[4] = {"Debug", "Info", "Warning", "Error"};
   Print *p_out = &VS1053_LOG_PORT;
+
+  /// Writes the level information and returns its length
+  size_t prefix(uint8_t level, char *log_buffer) {
+    strcpy(log_buffer,"VS1053 - ");
+    strcat(log_buffer, VS1053_log_msg[level]);
+    strcat(log_buffer, ":     ");
+    return strlen(log_buffer);
+  }
+
+#if USE_TASKS
+  VS1053LogQueue *p_queue = nullptr;
+  std::atomic<uint32_t> dropped_count{0};
+
+  /// Formats a deferred message
+  void format(const VS1053LogEntry &entry, char *out, size_t size);
+
+  static void store_args(VS1053LogEntry &) {}
+
+  template <typename T, typename... Args>
+  static void store_args(VS1053LogEntry &entry, T value, Args... args) {
+    store_arg(entry, value);
+    store_args(entry, args...);
+  }
+
+  template <typename T>
+  static void store_arg(VS1053LogEntry &entry, T value) {
+    entry.args[entry.count++] = log_arg(value);
+  }
+
+  /// Strings are copied: the caller's buffer might have been released when the message is printed
+  static void store_arg(VS1053LogEntry &entry, const char *value);
+
+  static void store_arg(VS1053LogEntry &entry, char *value) { store_arg(entry, (const char *)value); }
+
+  template <typename T>
+  static typename std::enable_if<std::is_floating_point<T>::value, VS1053LogArg>::type log_arg(T value) {
+    VS1053LogArg result;
+    result.d = value;
+    return result;
+  }
+
+  template <typename T>
+  static typename std::enable_if<std::is_pointer<T>::value, VS1053LogArg>::type log_arg(T value) {
+    VS1053LogArg result;
+    result.p = (const void *)value;
+    return result;
+  }
+
+  template <typename T>
+  static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, VS1053LogArg>::type log_arg(
+      T value) {
+    VS1053LogArg result;
+    result.u = static_cast<unsigned long long>(value);
+    return result;
+  }
+#endif
 };
 
 extern VS1053LoggerClass VS1053Logger;
 
-#define VS1053_LOGD(fmt, ...) VS1053Logger.log(VS1053Debug, fmt, ##__VA_ARGS__)
-#define VS1053_LOGI(fmt, ...) VS1053Logger.log(VS1053Info, fmt, ##__VA_ARGS__)
-#define VS1053_LOGW(fmt, ...) VS1053Logger.log(VS1053Warning, fmt, ##__VA_ARGS__)
-#define VS1053_LOGE(fmt, ...) VS1053Logger.log(VS1053Error, fmt, ##__VA_ARGS__)
+// the arguments are only evaluated if the level is active
+#if USE_TASKS
+#define VS1053_LOG(level, fmt, ...) \
+  do { if (VS1053Logger.isLogging(level)) VS1053Logger.logArgs(level, fmt, ##__VA_ARGS__); } while (0)
+#else
+#define VS1053_LOG(level, fmt, ...) \
+  do { if (VS1053Logger.isLogging(level)) VS1053Logger.log(level, fmt, ##__VA_ARGS__); } while (0)
+#endif
+
+// removed by the compiler: the arguments are still checked, so they are not reported as unused
+#define VS1053_LOG_NONE(level, fmt, ...) \
+  do { if (false) VS1053Logger.log(level, fmt, ##__VA_ARGS__); } while (0)
+
+#if VS1053_LOG_MIN_LEVEL <= 0
+#define VS1053_LOGD(fmt, ...) VS1053_LOG(VS1053Debug, fmt, ##__VA_ARGS__)
+#else
+#define VS1053_LOGD(fmt, ...) VS1053_LOG_NONE(VS1053Debug, fmt, ##__VA_ARGS__)
+#endif
+#if VS1053_LOG_MIN_LEVEL <= 1
+#define VS1053_LOGI(fmt, ...) VS1053_LOG(VS1053Info, fmt, ##__VA_ARGS__)
+#else
+#define VS1053_LOGI(fmt, ...) VS1053_LOG_NONE(VS1053Info, fmt, ##__VA_ARGS__)
+#endif
+#if VS1053_LOG_MIN_LEVEL <= 2
+#define VS1053_LOGW(fmt, ...) VS1053_LOG(VS1053Warning, fmt, ##__VA_ARGS__)
+#else
+#define VS1053_LOGW(fmt, ...) VS1053_LOG_NONE(VS1053Warning, fmt, ##__VA_ARGS__)
+#endif
+#if VS1053_LOG_MIN_LEVEL <= 3
+#define VS1053_LOGE(fmt, ...) VS1053_LOG(VS1053Error, fmt, ##__VA_ARGS__)
+#else
+#define VS1053_LOGE(fmt, ...) VS1053_LOG_NONE(VS1053Error, fmt, ##__VA_ARGS__)
+#endif
 
-} // namespace arduino_vs1053
\ No newline at end of file
+} // namespace arduino_vs1053
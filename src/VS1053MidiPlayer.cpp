@@ -0,0 +1,263 @@
+#include "VS1053MidiPlayer.h"
+#if USE_MIDI
+
+namespace arduino_vs1053 {
+
+static uint32_t midi_be32(const uint8_t *data) {
+    return (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 | (uint32_t)data[2] << 8 | data[3];
+}
+
+bool VS1053MidiPlayer::begin(VS1053MidiSource &source) {
+    end();
+    p_source = &source;
+    uint8_t header[14];
+    if (source.readAt(0, header, sizeof(header)) != sizeof(header) || memcmp(header, "MThd", 4) != 0) {
+        VS1053_LOGE("Not a MIDI file");
+        return false;
+    }
+    uint16_t format = header[8] << 8 | header[9];
+    uint16_t ntracks = header[10] << 8 | header[11];
+    uint16_t time_division = header[12] << 8 | header[13];
+    if (format > 1) {
+        VS1053_LOGE("MIDI format %d not supported", format);
+        return false;
+    }
+    if (ntracks > max_tracks) {
+        VS1053_LOGW("Only %d of %d tracks are played", max_tracks, ntracks);
+        ntracks = max_tracks;
+    }
+    if (ntracks > 1 && !source.isRandomAccess()) {
+        VS1053_LOGE("Multiple tracks need a source with random access");
+        return false;
+    }
+    if (time_division & 0x8000) {
+        // SMPTE: frames per second (negative) and ticks per frame
+        ticks_per_second = (uint32_t)(-(int8_t)(time_division >> 8)) * (time_division & 0xFF);
+    } else {
+        ticks_per_second = 0;
+        division = time_division == 0 ? 96 : time_division;
+    }
+
+    // locate the track chunks
+    uint32_t pos = 8 + midi_be32(header + 4);
+    track_count = 0;
+    while (track_count < ntracks) {
+        uint8_t chunk[8];
+        if (source.readAt(pos, chunk, sizeof(chunk)) != sizeof(chunk)) break;
+        uint32_t len = midi_be32(chunk + 4);
+        if (memcmp(chunk, "MTrk", 4) == 0) {
+            Track &track = tracks[track_count++];
+            track.pos = pos + 8;
+            track.end = pos + 8 + len;
+            track.tick = 0;
+            track.buffer_pos = track.buffer_len = 0;
+            track.running_status = 0;
+            track.is_done = false;
+        }
+        pos += 8 + len;
+        // a sequential source can not skip back to the first track
+        if (!source.isRandomAccess()) break;
+    }
+    if (track_count == 0) {
+        VS1053_LOGE("No MIDI track found");
+        return false;
+    }
+
+    // the first event of each track
+    for (uint8_t j = 0; j < track_count; j++) {
+        tracks[j].tick = read_vlq(tracks[j]);
+    }
+    tempo = 500000;
+    tempo_tick = 0;
+    tempo_us = 0;
+    last_us = micros();
+    elapsed_us = 0;
+    is_active = true;
+    return true;
+}
+
+void VS1053MidiPlayer::end() {
+    if (!is_active) return;
+    is_active = false;
+    // all notes off on all channels
+    vs.beginMidiBatch();
+    for (uint8_t channel = 0; channel < 16; channel++) {
+        vs.sendMidiMessage(0xB0 | channel, 123, 0);
+    }
+    vs.endMidiBatch();
+}
+
+bool VS1053MidiPlayer::update() {
+    if (!is_active) return false;
+    uint64_t now = now_us();
+    bool is_finished = false;
+    vs.beginMidiBatch();
+    while (true) {
+        Track *p_track = next_track();
+        if (p_track == nullptr) {
+            is_finished = true;
+            break;
+        }
+        if (event_us(p_track->tick) > now + lookahead_us) break;
+        play_event(*p_track);
+    }
+    vs.endMidiBatch();
+    // files which end without the matching note offs must not leave notes hanging
+    if (is_finished) end();
+    return is_active;
+}
+
+uint32_t VS1053MidiPlayer::nextEventDelay() {
+    Track *p_track = next_track();
+    if (!is_active || p_track == nullptr) return 0;
+    uint64_t now = now_us();
+    uint64_t at = event_us(p_track->tick);
+    return at > now + lookahead_us ? at - now - lookahead_us : 0;
+}
+
+/// Provides the track with the next event
+VS1053MidiPlayer::Track *VS1053MidiPlayer::next_track() {
+    Track *result = nullptr;
+    for (uint8_t j = 0; j < track_count; j++) {
+        Track &track = tracks[j];
+        if (!track.is_done && (result == nullptr || track.tick < result->tick)) result = &track;
+    }
+    return result;
+}
+
+/// Time in us since the start: we add up the differences, so the result does not wrap after 71 minutes
+uint64_t VS1053MidiPlayer::now_us() {
+    uint32_t time = micros();
+    elapsed_us += (uint32_t)(time - last_us);
+    last_us = time;
+    return elapsed_us;
+}
+
+/// Time of the indicated tick in us since the start
+uint64_t VS1053MidiPlayer::event_us(uint32_t tick) {
+    uint64_t ticks = tick - tempo_tick;
+    if (ticks_per_second > 0) return tempo_us + ticks * 1000000 / ticks_per_second;
+    return tempo_us + ticks * tempo / division;
+}
+
+int VS1053MidiPlayer::read_byte(Track &track) {
+    if (track.buffer_pos >= track.buffer_len) {
+        if (track.pos >= track.end) return -1;
+        size_t len = track.end - track.pos < sizeof(track.buffer) ? track.end - track.pos : sizeof(track.buffer);
+        track.buffer_len = p_source->readAt(track.pos, track.buffer, len);
+        track.buffer_pos = 0;
+        track.pos += track.buffer_len;
+        if (track.buffer_len == 0) {
+            track.pos = track.end;
+            return -1;
+        }
+    }
+    return track.buffer[track.buffer_pos++];
+}
+
+/// Reads a variable length quantity
+uint32_t VS1053MidiPlayer::read_vlq(Track &track) {
+    uint32_t result = 0;
+    for (int j = 0; j < 4; j++) {
+        int value = read_byte(track);
+        if (value < 0) {
+            track.is_done = true;
+            break;
+        }
+        result = (result << 7) | (value & 0x7F);
+        if ((value & 0x80) == 0) break;
+    }
+    return result;
+}
+
+void VS1053MidiPlayer::skip(Track &track, uint32_t len) {
+    while (len-- > 0 && read_byte(track) >= 0) {
+    }
+}
+
+/// Sends or processes the next event of the track and reads the time of the following event
+void VS1053MidiPlayer::play_event(Track &track) {
+    int value = read_byte(track);
+    if (value < 0) {
+        track.is_done = true;
+        return;
+    }
+    uint8_t msg[3];
+    uint8_t len = 0;
+    uint8_t status = value;
+    if (value < 0x80) {
+        // running status: the value is the first data byte
+        status = track.running_status;
+        if (status == 0) {
+            VS1053_LOGE("Invalid MIDI data");
+            track.is_done = true;
+            return;
+        }
+        msg[1] = value;
+        len = 1;
+    }
+
+    if (status == 0xFF) {
+        // meta event
+        int type = read_byte(track);
+        uint32_t size = read_vlq(track);
+        if (type == 0x51 && size == 3) {
+            // set tempo: the following events are calculated from this point in time
+            uint32_t value = 0;
+            for (int j = 0; j < 3; j++) {
+                int data = read_byte(track);
+                if (data < 0) {
+                    track.is_done = true;
+                    return;
+                }
+                value = (value << 8) | data;
+            }
+            tempo_us = event_us(track.tick);
+            tempo_tick = track.tick;
+            tempo = value;
+        } else if (type == 0x2F || type < 0) {
+            track.is_done = true;
+            return;
+        } else {
+            skip(track, size);
+        }
+    } else if (status == 0xF0 || status == 0xF7) {
+        send_sysex(track, status, read_vlq(track));
+    } else {
+        if (status < 0xF0) track.running_status = status;
+        msg[0] = status;
+        uint8_t size = 1 + VS1053MidiQueue::dataLength(status);
+        for (len++; len < size; len++) {
+            int data = read_byte(track);
+            if (data < 0) {
+                track.is_done = true;
+                return;
+            }
+            msg[len] = data;
+        }
+        vs.sendMidi(msg, size);
+    }
+
+    track.tick += read_vlq(track);
+}
+
+/// SysEx (F0) or escaped data (F7) which is sent in small pieces
+void VS1053MidiPlayer::send_sysex(Track &track, uint8_t status, uint32_t len) {
+    if (status == 0xF0) vs.sendMidi(&status, 1);
+    uint8_t data[16];
+    while (len > 0) {
+        uint8_t n = 0;
+        while (n < sizeof(data) && n < len) {
+            int value = read_byte(track);
+            if (value < 0) break;
+            data[n++] = value;
+        }
+        if (n == 0) break;
+        vs.sendMidi(data, n);
+        len -= n;
+    }
+}
+
+}
+
+#endif
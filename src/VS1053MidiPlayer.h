@@ -0,0 +1,166 @@
+#pragma once
+#include "VS1053Config.h"
+#if USE_MIDI
+#include <string.h>
+#include "VS1053Driver.h"
+
+namespace arduino_vs1053 {
+
+/**
+ * @brief Provides the content of a Standard MIDI File to the VS1053MidiPlayer
+ * @author pschatzmann
+ */
+class VS1053MidiSource {
+  public:
+    virtual ~VS1053MidiSource() = default;
+    /// Reads up to len bytes starting at pos and returns the number of bytes which were read
+    virtual size_t readAt(uint32_t pos, uint8_t *data, size_t len) = 0;
+    /// Returns true if the data can be read in any order: needed for files with multiple tracks
+    virtual bool isRandomAccess() { return true; }
+};
+
+/**
+ * @brief MIDI file in memory (e.g. a PROGMEM array on the ESP32)
+ * @author pschatzmann
+ */
+class VS1053MidiMemorySource : public VS1053MidiSource {
+  public:
+    VS1053MidiMemorySource(const uint8_t *data, size_t size) : data(data), size(size) {}
+
+    size_t readAt(uint32_t pos, uint8_t *out, size_t len) override {
+        if (pos >= size) return 0;
+        if (len > size - pos) len = size - pos;
+        memcpy(out, data + pos, len);
+        return len;
+    }
+
+  protected:
+    const uint8_t *data;
+    size_t size;
+};
+
+/**
+ * @brief MIDI file which is read from any class which provides seek() and
+ * read(data, len): e.g. a File on a SD card or LittleFS
+ * @author pschatzmann
+ */
+template <class T>
+class VS1053MidiFileSource : public VS1053MidiSource {
+  public:
+    VS1053MidiFileSource(T &file) : file(file) {}
+
+    size_t readAt(uint32_t pos, uint8_t *data, size_t len) override {
+        if (pos != position && !file.seek(pos)) return 0;
+        size_t result = file.read(data, len);
+        position = pos + result;
+        return result;
+    }
+
+  protected:
+    T &file;
+    uint32_t position = 0;
+};
+
+/**
+ * @brief MIDI file which is read sequentially from a Stream: only files with one
+ * track (e.g. format 0) are supported
+ * @author pschatzmann
+ */
+class VS1053MidiStreamSource : public VS1053MidiSource {
+  public:
+    VS1053MidiStreamSource(Stream &in) : in(in) {}
+
+    size_t readAt(uint32_t pos, uint8_t *data, size_t len) override {
+        if (pos < position) return 0;
+        while (position < pos) {
+            if (in.read() < 0) return 0;
+            position++;
+        }
+        size_t result = in.readBytes(data, len);
+        position += result;
+        return result;
+    }
+
+    bool isRandomAccess() override { return false; }
+
+  protected:
+    Stream &in;
+    uint32_t position = 0;
+};
+
+/**
+ * @brief Plays a Standard MIDI File (format 0 or 1) with the real time MIDI mode of
+ * the VS1053. The tracks are parsed incrementally with a small buffer per track and
+ * merged. Call update() in the loop: all events which are due (within the look-ahead)
+ * are sent in one batch. The event times are calculated from the start time, so
+ * a delay in the loop does not accumulate. No memory is allocated.
+ * @author pschatzmann
+ */
+class VS1053MidiPlayer {
+  public:
+    /// Max number of tracks
+    static const uint8_t max_tracks = 16;
+
+    VS1053MidiPlayer(VS1053 &vs1053) : vs(vs1053) {}
+
+    /// Parses the header and starts the playback: call beginMidi() on the VS1053 first
+    bool begin(VS1053MidiSource &source);
+
+    /// Stops the playback and turns all notes off
+    void end();
+
+    /// Sends the events which are due: returns false when the playback has ended (all notes are turned off)
+    bool update();
+
+    /// Returns true while the playback is active
+    bool isActive() { return is_active; }
+
+    /// Time in us until the next event is due
+    uint32_t nextEventDelay();
+
+    /// Events which are due within the indicated time in us are sent in advance (default 1000)
+    void setLookAhead(uint32_t us) { lookahead_us = us; }
+
+    /// Number of tracks of the actual file
+    uint8_t trackCount() { return track_count; }
+
+  protected:
+    /// Parser state of an individual track
+    struct Track {
+        uint32_t pos;           // next position in the source which needs to be read
+        uint32_t end;           // end position of the track data
+        uint32_t tick;          // absolute time of the next event in ticks
+        uint8_t buffer[16];
+        uint8_t buffer_pos;
+        uint8_t buffer_len;
+        uint8_t running_status;
+        bool is_done;
+    };
+
+    VS1053 &vs;
+    VS1053MidiSource *p_source = nullptr;
+    Track tracks[max_tracks];
+    uint8_t track_count = 0;
+    uint16_t division = 96;         // ticks per quarter note
+    uint32_t ticks_per_second = 0;  // SMPTE time division (0 if not used)
+    uint32_t tempo = 500000;        // us per quarter note
+    uint32_t tempo_tick = 0;        // tick of the last tempo change
+    uint64_t tempo_us = 0;          // time in us of the last tempo change
+    uint32_t last_us = 0;           // micros() of the last elapsed_us update
+    uint64_t elapsed_us = 0;        // time since the start: does not wrap like micros()
+    uint32_t lookahead_us = 1000;
+    bool is_active = false;
+
+    int read_byte(Track &track);
+    uint32_t read_vlq(Track &track);
+    void skip(Track &track, uint32_t len);
+    Track *next_track();
+    uint64_t event_us(uint32_t tick);
+    uint64_t now_us();
+    void play_event(Track &track);
+    void send_sysex(Track &track, uint8_t status, uint32_t len);
+};
+
+}
+
+#endif
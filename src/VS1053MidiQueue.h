@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace arduino_vs1053 {
+
+/**
+ * @brief Collects MIDI bytes so that multiple messages can be sent in one transaction.
+ * It also keeps track of the running status, so that repeated status bytes can be omitted.
+ * @author pschatzmann
+ */
+class VS1053MidiQueue {
+  public:
+    /// Max number of MIDI bytes which can be queued
+    static const size_t capacity = 64;
+
+    /// Number of data bytes which follow the status byte
+    static uint8_t dataLength(uint8_t status) {
+        switch (status & 0xF0) {
+            case 0xC0:
+            case 0xD0:
+                return 1;
+            case 0xF0:
+                if (status == 0xF1 || status == 0xF3) return 1;
+                return status == 0xF2 ? 2 : 0;
+            default:
+                return status >= 0x80 ? 2 : 0;
+        }
+    }
+
+    /// Updates the running status: returns true if the status byte can be omitted
+    bool isRunningStatus(uint8_t status) {
+        // real time messages do not change the running status
+        if (status < 0x80 || status >= 0xF8) return false;
+        if (status >= 0xF0) {
+            // system common messages and SysEx cancel the running status
+            running_status = 0;
+            return false;
+        }
+        if (status == running_status) return true;
+        running_status = status;
+        return false;
+    }
+
+    /// The receiver state is unknown: the next message needs to send the status byte
+    void resetRunningStatus() { running_status = 0; }
+
+    /// Adds the bytes and returns the number of bytes which were accepted
+    size_t write(const uint8_t *data, size_t len) {
+        size_t n = len < capacity - count ? len : capacity - count;
+        memcpy(buffer + count, data, n);
+        count += n;
+        return n;
+    }
+
+    /// Queued MIDI bytes
+    const uint8_t *data() { return buffer; }
+
+    /// Number of queued MIDI bytes
+    size_t size() { return count; }
+
+    /// Removes all queued bytes
+    void clear() { count = 0; }
+
+  protected:
+    uint8_t buffer[capacity];
+    size_t count = 0;
+    uint8_t running_status = 0;
+};
+
+}
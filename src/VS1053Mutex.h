@@ -0,0 +1,66 @@
+#pragma once
+#include "VS1053Config.h"
+#if USE_TASKS && !defined(ARDUINO_ARCH_ESP32)
+#include <mutex>
+#endif
+
+namespace arduino_vs1053 {
+
+#if USE_TASKS
+
+/**
+ * @brief Recursive mutex which serializes the public methods of the VS1053 when it is
+ * used by several tasks (e.g. by the VS1053Feeder and the loop): FreeRTOS on the
+ * ESP32, std::recursive_mutex outside of Arduino.
+ * @author pschatzmann
+ */
+class VS1053Mutex {
+  public:
+#ifdef ARDUINO_ARCH_ESP32
+    VS1053Mutex() { handle = xSemaphoreCreateRecursiveMutex(); }
+    ~VS1053Mutex() { vSemaphoreDelete(handle); }
+    void lock() { xSemaphoreTakeRecursive(handle, portMAX_DELAY); }
+    void unlock() { xSemaphoreGiveRecursive(handle); }
+#else
+    VS1053Mutex() = default;
+    void lock() { mtx.lock(); }
+    void unlock() { mtx.unlock(); }
+#endif
+    VS1053Mutex(const VS1053Mutex &) = delete;
+    VS1053Mutex &operator=(const VS1053Mutex &) = delete;
+
+  protected:
+#ifdef ARDUINO_ARCH_ESP32
+    SemaphoreHandle_t handle = nullptr;
+#else
+    std::recursive_mutex mtx;
+#endif
+};
+
+#else
+
+/// Without tasks there is nothing to lock
+class VS1053Mutex {
+  public:
+    void lock() {}
+    void unlock() {}
+};
+
+#endif
+
+/**
+ * @brief Locks the mutex for the lifetime of the object
+ * @author pschatzmann
+ */
+class VS1053LockGuard {
+  public:
+    VS1053LockGuard(VS1053Mutex &mutex) : mutex(mutex) { mutex.lock(); }
+    ~VS1053LockGuard() { mutex.unlock(); }
+    VS1053LockGuard(const VS1053LockGuard &) = delete;
+    VS1053LockGuard &operator=(const VS1053LockGuard &) = delete;
+
+  protected:
+    VS1053Mutex &mutex;
+};
+
+}
@@ -0,0 +1,74 @@
+#include "VS1053Patches.h"
+#include <string.h>
+#ifdef ARDUINO
+#include "Arduino.h"
+#else
+#include "VS1053Ext.h"
+#endif
+
+#if USE_PATCHES
+#include "patches/vs1053b-patches.h"
+#endif
+#if USE_PATCHES_EXTENDED
+#include "patches/vs1053b-patches-flac.plg"
+static const unsigned short PATCHES_FLAC_SIZE = PLUGIN_SIZE;
+#undef PLUGIN_SIZE
+#include "patches/vs1053b-patches-latm.plg"
+static const unsigned short PATCHES_LATM_SIZE = PLUGIN_SIZE;
+#undef PLUGIN_SIZE
+#include "patches/vs1053b-patches-flac-latm.plg"
+static const unsigned short PATCHES_FLAC_LATM_SIZE = PLUGIN_SIZE;
+#undef PLUGIN_SIZE
+#include "patches/vs1053b-patches-pitch.plg"
+static const unsigned short PATCHES_PITCH_SIZE = PLUGIN_SIZE;
+#undef PLUGIN_SIZE
+#endif
+
+namespace arduino_vs1053 {
+
+#if USE_PATCHES
+static const VS1053Patch patches[] = {
+    {"generic", VS1053_PATCH_BASE, PATCHES, PATCHES_SIZE},
+#if USE_PATCHES_EXTENDED
+    {"latm", VS1053_PATCH_LATM, PATCHES_LATM, PATCHES_LATM_SIZE},
+    {"pitch", VS1053_PATCH_PITCH, PATCHES_PITCH, PATCHES_PITCH_SIZE},
+    {"flac", VS1053_PATCH_FLAC, PATCHES_FLAC, PATCHES_FLAC_SIZE},
+    {"flac-latm", VS1053_PATCH_FLAC | VS1053_PATCH_LATM, PATCHES_FLAC_LATM, PATCHES_FLAC_LATM_SIZE},
+#endif
+};
+static const size_t patch_count = sizeof(patches) / sizeof(patches[0]);
+#else
+static const VS1053Patch *patches = nullptr;
+static const size_t patch_count = 0;
+#endif
+
+size_t VS1053PatchRegistry::count() {
+    return patch_count;
+}
+
+const VS1053Patch *VS1053PatchRegistry::get(size_t index) {
+    return index < patch_count ? &patches[index] : nullptr;
+}
+
+const VS1053Patch *VS1053PatchRegistry::find(uint8_t capabilities) {
+    const VS1053Patch *result = nullptr;
+    for (size_t j = 0; j < patch_count; j++) {
+        const VS1053Patch &patch = patches[j];
+        if ((patch.capabilities & capabilities) != capabilities) continue;
+        if (result == nullptr || patch.size < result->size) result = &patch;
+    }
+    return result;
+}
+
+uint8_t VS1053PatchRegistry::sniff(const uint8_t *data, size_t len) {
+    // native FLAC
+    if (len >= 4 && memcmp(data, "fLaC", 4) == 0) return VS1053_PATCH_FLAC;
+    // Ogg FLAC: the first packet starts with 0x7F "FLAC"
+    if (len >= 33 && memcmp(data, "OggS", 4) == 0 && memcmp(data + 28, "\x7F" "FLAC", 5) == 0)
+        return VS1053_PATCH_FLAC;
+    // LOAS/LATM: 11 bit sync word 0x2B7
+    if (len >= 2 && data[0] == 0x56 && (data[1] & 0xE0) == 0xE0) return VS1053_PATCH_LATM;
+    return VS1053_PATCH_BASE;
+}
+
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "VS1053Config.h"
+#include <stdint.h>
+#include <stddef.h>
+
+namespace arduino_vs1053 {
+
+/// Capabilities which are provided by a patch: can be combined
+enum VS1053_PATCH_CAPABILITY {
+    VS1053_PATCH_BASE = 0,      // generic fixes and improvements
+    VS1053_PATCH_FLAC = 1,      // FLAC decoder
+    VS1053_PATCH_LATM = 2,      // AAC LATM/LOAS decoder
+    VS1053_PATCH_PITCH = 4      // pitch shifter and speed control
+};
+
+/// Patch in the compressed plugin format
+struct VS1053Patch {
+    const char *name;
+    uint8_t capabilities;
+    const unsigned short *data;
+    unsigned short size;
+};
+
+/**
+ * @brief Registry of the VS1053 patches which are part of this library. The FLAC,
+ * LATM and pitch patches are only available if USE_PATCHES_EXTENDED is active.
+ * @author pschatzmann
+ */
+class VS1053PatchRegistry {
+  public:
+    /// Number of available patches
+    static size_t count();
+
+    /// Provides the patch at the indicated index (nullptr if the index is not valid)
+    static const VS1053Patch *get(size_t index);
+
+    /// Provides the smallest patch which supports all requested capabilities (nullptr if there is none)
+    static const VS1053Patch *find(uint8_t capabilities);
+
+    /// Determines the required capabilities from the first bytes of an audio stream
+    static uint8_t sniff(const uint8_t *data, size_t len);
+};
+
+}
@@ -0,0 +1,130 @@
+#include "VS1053PluginLoader.h"
+#include <ctype.h>
+
+namespace arduino_vs1053 {
+
+bool VS1053PluginLoader::load(Stream &in, VS1053_PLUGIN_FORMAT fmt) {
+    // other tasks (e.g. the VS1053Feeder) must not access the chip during the upload
+    VS1053LockGuard guard(vs.mutex);
+    VS1053_LOGI("Loading User Code from Stream");
+    p_in = &in;
+    format = fmt;
+    buffer_pos = buffer_len = 0;
+    word_count = 0;
+    // the VS1053 supports SCI multiple writes
+    is_multiple_write = vs.getChipVersion() == 4;
+
+    if (format == VS1053_PLUGIN_AUTO) {
+        // binary plugins start with a register address (< 16) as little endian word
+        int first = next_byte();
+        int second = peek_byte();
+        if (first < 0) return false;
+        buffer_pos--;
+        format = first < 0x10 && second == 0 ? VS1053_PLUGIN_BINARY : VS1053_PLUGIN_TEXT;
+    }
+
+    uint16_t addr, n, val;
+    while (next_word(addr)) {
+        if (addr > 0xF || !next_word(n)) {
+            VS1053_LOGE("Invalid plugin at word %d", (int)word_count);
+            return false;
+        }
+        if (n & 0x8000U) { /* RLE run, replicate n samples */
+            if (!next_word(val)) {
+                VS1053_LOGE("Invalid plugin at word %d", (int)word_count);
+                return false;
+            }
+            write_repeat(addr, val, n & 0x7FFF);
+        } else {           /* Copy run, copy n samples */
+            while (n > 0) {
+                size_t count = 0;
+                while (count < n && count < words_size && next_word(words[count])) count++;
+                if (count == 0) {
+                    VS1053_LOGE("Plugin ended unexpectedly");
+                    return false;
+                }
+                write_words(addr, count);
+                n -= count;
+            }
+        }
+    }
+    VS1053_LOGD("User Code - done: %d words", (int)word_count);
+    return true;
+}
+
+int VS1053PluginLoader::next_byte() {
+    if (buffer_pos >= buffer_len) {
+        buffer_len = p_in->readBytes(buffer, buffer_size);
+        buffer_pos = 0;
+        if (buffer_len == 0) return -1;
+    }
+    return buffer[buffer_pos++];
+}
+
+int VS1053PluginLoader::peek_byte() {
+    int result = next_byte();
+    if (result >= 0) buffer_pos--;
+    return result;
+}
+
+bool VS1053PluginLoader::next_word(uint16_t &word) {
+    bool result;
+    if (format == VS1053_PLUGIN_BINARY) {
+        int lo = next_byte();
+        int hi = next_byte();
+        result = lo >= 0 && hi >= 0;
+        word = lo | (hi << 8);
+    } else {
+        result = next_text_word(word);
+    }
+    if (result) word_count++;
+    return result;
+}
+
+/// Provides the next 0x hex value: comments, preprocessor lines and other tokens are skipped
+bool VS1053PluginLoader::next_text_word(uint16_t &word) {
+    int ch;
+    while ((ch = next_byte()) >= 0) {
+        if (ch == '/' && peek_byte() == '*') {
+            int last = 0;
+            while ((ch = next_byte()) >= 0 && !(last == '*' && ch == '/')) last = ch;
+        } else if ((ch == '/' && peek_byte() == '/') || ch == '#') {
+            while ((ch = next_byte()) >= 0 && ch != '\n');
+        } else if (isalnum(ch) || ch == '_') {
+            bool is_hex = ch == '0' && (peek_byte() == 'x' || peek_byte() == 'X');
+            uint16_t value = 0;
+            if (is_hex) next_byte();
+            while ((ch = peek_byte()) >= 0 && (isalnum(ch) || ch == '_')) {
+                next_byte();
+                if (is_hex && isxdigit(ch)) {
+                    value = (value << 4) | (isdigit(ch) ? ch - '0' : (tolower(ch) - 'a' + 10));
+                }
+            }
+            if (is_hex) {
+                word = value;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void VS1053PluginLoader::write_words(uint8_t reg, size_t n) {
+    VS1053SciSession session(vs, true);
+    if (is_multiple_write) {
+        session.writeMultiple(reg, words, n);
+    } else {
+        for (size_t j = 0; j < n; j++) session.write(reg, words[j]);
+    }
+}
+
+void VS1053PluginLoader::write_repeat(uint8_t reg, uint16_t value, size_t n) {
+    VS1053SciSession session(vs, true);
+    if (is_multiple_write) {
+        session.writeRepeat(reg, value, n);
+    } else {
+        while (n--) session.write(reg, value);
+    }
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "VS1053Driver.h"
+
+namespace arduino_vs1053 {
+
+/// Representation of a plugin in a Stream
+enum VS1053_PLUGIN_FORMAT {
+    VS1053_PLUGIN_AUTO,     // determined from the first bytes
+    VS1053_PLUGIN_BINARY,   // 16 bit little endian words
+    VS1053_PLUGIN_TEXT      // .plg source file with 0x hex values
+};
+
+/**
+ * @brief Uploads a compressed plugin (address, count/RLE flag, data) from a Stream
+ * (e.g. a File on a SD card or LittleFS) with small fixed buffers, so that the
+ * plugin does not need to be in flash or RAM. The stream is only read while the
+ * SPI bus is released, so it can be on the same SPI bus as the VS1053. The driver
+ * is locked during the whole upload, so a VS1053Feeder waits until it has finished.
+ * @author pschatzmann
+ */
+class VS1053PluginLoader {
+  public:
+    VS1053PluginLoader(VS1053 &vs1053) : vs(vs1053) {}
+
+    /// Loads the plugin: returns false if the data is not valid
+    bool load(Stream &in, VS1053_PLUGIN_FORMAT format = VS1053_PLUGIN_AUTO);
+
+    /// Number of words which were read by the last load()
+    size_t wordCount() { return word_count; }
+
+  protected:
+    static const size_t buffer_size = 128;
+    static const size_t words_size = 64;
+    VS1053 &vs;
+    Stream *p_in = nullptr;
+    VS1053_PLUGIN_FORMAT format = VS1053_PLUGIN_AUTO;
+    uint8_t buffer[buffer_size];
+    size_t buffer_pos = 0;
+    size_t buffer_len = 0;
+    uint16_t words[words_size];
+    size_t word_count = 0;
+    bool is_multiple_write = false;
+
+    int next_byte();
+    int peek_byte();
+    bool next_word(uint16_t &word);
+    bool next_text_word(uint16_t &word);
+    void write_words(uint8_t reg, size_t n);
+    void write_repeat(uint8_t reg, uint16_t value, size_t n);
+};
+
+}
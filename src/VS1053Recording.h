@@ -12,6 +12,13 @@ enum VS1053_INPUT {
     VS1053_AUX = 1,
 };
 
+/// Recording format
+enum VS1053_RECORDING_FORMAT {
+    VS1053_PCM = 0,     // 16 bit linear PCM
+    VS1053_ADPCM = 1,   // IMA ADPCM: blocks of 256 bytes per channel with 505 samples
+    VS1053_OGG = 2,     // Ogg Vorbis pages: needs the encoder plugin (VS1053 only)
+};
+
 /**
  * @brief Relevant control data for recording audio from the vs1053
  * @author pschatzmann
@@ -64,12 +71,57 @@ struct VS1053Recording {
             input = in;
         }  
 
+        /// Defines the recording format: IMA ADPCM needs only a quarter of the bandwidth
+        void setFormat(VS1053_RECORDING_FORMAT fmt){
+            format_v = fmt;
+        }
+
+        VS1053_RECORDING_FORMAT format() {
+            return format_v;
+        }
+
+        /// Defines the Ogg Vorbis encoder plugin (e.g. converted from venc16k1q05.plg)
+        void setEncoder(const uint16_t *plugin, uint16_t size){
+            p_encoder = plugin;
+            encoder_size = size;
+            p_encoder_stream = nullptr;
+        }
+
+        /// Loads the Ogg Vorbis encoder plugin from a Stream (e.g. a File on a SD card)
+        void setEncoder(Stream &in){
+            p_encoder_stream = &in;
+            p_encoder = nullptr;
+        }
+
+        // Ogg Vorbis quality from 0 (lowest) to 10 (highest)
+        void setQuality(uint8_t q){
+            quality = q > 10 ? 10 : q;
+            bitrate_kbps = 0;
+        }
+
+        // Ogg Vorbis nominal bitrate in kbit/s: replaces the quality setting
+        void setBitrate(uint16_t kbps){
+            bitrate_kbps = kbps > 0xFFF ? 0xFFF : kbps;
+        }
+
+        /// Ogg Vorbis profile as expected in SCI_WRAMADDR by the encoder
+        uint16_t encoderProfile() {
+            // bits 15-14: mode (0=quality, 1=nominal bitrate), bits 13-12: multiplier (3=1000)
+            return bitrate_kbps == 0 ? quality : 0x4000 | 0x3000 | bitrate_kbps;
+        }
+
 protected:
     uint16_t sample_rate = 8000;
     uint8_t channels_v = 1;
     uint16_t recording_gain = 0; // 
     uint16_t autogain_amplification = 0; // 
     VS1053_INPUT input = VS1053_MIC;
+    VS1053_RECORDING_FORMAT format_v = VS1053_PCM;
+    const uint16_t *p_encoder = nullptr;
+    uint16_t encoder_size = 0;
+    Stream *p_encoder_stream = nullptr;
+    uint8_t quality = 5;
+    uint16_t bitrate_kbps = 0;
 };   
 
 }
\ No newline at end of file
@@ -0,0 +1,112 @@
+#pragma once
+#include "VS1053Config.h"
+#if USE_TASKS
+#include <atomic>
+#include <new>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace arduino_vs1053 {
+
+/**
+ * @brief Lock-free single producer / single consumer ring buffer. One task is
+ * writing and another task is reading without any locking. The size is rounded
+ * up to a power of 2.
+ * @author pschatzmann
+ */
+class VS1053RingBuffer {
+  public:
+    VS1053RingBuffer() = default;
+    VS1053RingBuffer(const VS1053RingBuffer &) = delete;
+    VS1053RingBuffer &operator=(const VS1053RingBuffer &) = delete;
+    ~VS1053RingBuffer() { end(); }
+
+    /// Allocates the buffer
+    bool begin(size_t size) {
+        end();
+        size_t capacity = 1;
+        while (capacity < size) capacity <<= 1;
+        buffer = new (std::nothrow) uint8_t[capacity];
+        if (buffer == nullptr) return false;
+        mask = capacity - 1;
+        reset();
+        return true;
+    }
+
+    /// Releases the buffer
+    void end() {
+        delete[] buffer;
+        buffer = nullptr;
+        mask = 0;
+    }
+
+    /// Clears the content: only call when neither the producer nor the consumer is active
+    void reset() {
+        head.store(0);
+        tail.store(0);
+    }
+
+    /// Capacity in bytes
+    size_t size() const { return buffer == nullptr ? 0 : mask + 1; }
+
+    /// Number of bytes which can be read
+    size_t available() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    /// Number of bytes which can be written
+    size_t availableForWrite() const { return size() - available(); }
+
+    /// Producer: adds the data and returns the number of bytes which were accepted
+    size_t write(const uint8_t *data, size_t len) {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t free = size() - (h - tail.load(std::memory_order_acquire));
+        if (len > free) len = free;
+        size_t pos = h & mask;
+        size_t first = len < size() - pos ? len : size() - pos;
+        memcpy(buffer + pos, data, first);
+        memcpy(buffer, data + first, len - first);
+        head.store(h + len, std::memory_order_release);
+        return len;
+    }
+
+    /// Consumer: copies the data and returns the number of bytes which were read
+    size_t read(uint8_t *data, size_t len) {
+        const uint8_t *ptr;
+        size_t result = 0;
+        while (result < len) {
+            size_t n = peek(&ptr);
+            if (n == 0) break;
+            if (n > len - result) n = len - result;
+            memcpy(data + result, ptr, n);
+            consume(n);
+            result += n;
+        }
+        return result;
+    }
+
+    /// Consumer: provides the contiguous readable region without copying
+    size_t peek(const uint8_t **ptr) const {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t len = head.load(std::memory_order_acquire) - t;
+        size_t pos = t & mask;
+        *ptr = buffer + pos;
+        return len < size() - pos ? len : size() - pos;
+    }
+
+    /// Consumer: removes the bytes which were processed after peek()
+    void consume(size_t len) {
+        tail.store(tail.load(std::memory_order_relaxed) + len, std::memory_order_release);
+    }
+
+  protected:
+    uint8_t *buffer = nullptr;
+    size_t mask = 0;
+    std::atomic<size_t> head{0}; // write position
+    std::atomic<size_t> tail{0}; // read position
+};
+
+}
+
+#endif
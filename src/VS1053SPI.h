@@ -10,6 +10,12 @@
 
 namespace arduino_vs1053 {
 
+/// Part of the data which is written with write_gather()
+struct VS1053_SPIBuffer {
+    const uint8_t *data;
+    uint32_t size;
+};
+
 /**
  * @brief Abstract SPI Driver for VS1053. We support different alternative implementations.
  * Outside of Arduino you need to provide your own
@@ -23,11 +29,60 @@ class VS1053_SPI {
     virtual void endTransaction() = 0;
     virtual void set_speed(uint32_t speed)= 0;
 
+    /// Locks the bus with the indicated SPI clock: override, so that the speed is only changed when we own the bus
+    virtual void beginTransaction(uint32_t speed) {
+        set_speed(speed);
+        beginTransaction();
+    }
+
     virtual  void write(uint8_t data) = 0;
     virtual  void write16(uint16_t data)= 0;
     virtual  void write_bytes(uint8_t * data, uint32_t size) = 0;
     virtual  uint8_t transfer(uint8_t data) = 0;
     virtual uint16_t read16(uint16_t port) = 0;
+
+    /// Writes the value count times: override if the platform supports a pattern fill
+    virtual void write_repeat(uint8_t value, uint32_t count) {
+        uint8_t buffer[32];
+        while (count > 0) {
+            uint32_t n = count < sizeof(buffer) ? count : sizeof(buffer);
+            // some platforms overwrite the buffer with the received data
+            memset(buffer, value, n);
+            write_bytes(buffer, n);
+            count -= n;
+        }
+    }
+
+    /// Writes each data byte preceded by the prefix (e.g. 0x00 for MIDI data)
+    virtual void write_interleaved(uint8_t prefix, const uint8_t *data, uint32_t size) {
+        uint8_t buffer[64];
+        while (size > 0) {
+            uint32_t n = size < sizeof(buffer) / 2 ? size : sizeof(buffer) / 2;
+            for (uint32_t j = 0; j < n; j++) {
+                buffer[j * 2] = prefix;
+                buffer[j * 2 + 1] = data[j];
+            }
+            write_bytes(buffer, n * 2);
+            data += n;
+            size -= n;
+        }
+    }
+
+    /// Writes multiple buffers as one transfer
+    virtual void write_gather(const VS1053_SPIBuffer *buffers, size_t count) {
+        for (size_t j = 0; j < count; j++) {
+            write_bytes(const_cast<uint8_t *>(buffers[j].data), buffers[j].size);
+        }
+    }
+
+    /// Starts to write the data (e.g. with DMA): the data must stay valid until await_write(). By default we write synchronously
+    virtual void write_bytes_async(const uint8_t *data, uint32_t size) { write_bytes(const_cast<uint8_t *>(data), size); }
+
+    /// Waits until the data of the last write_bytes_async() has been sent
+    virtual void await_write() {}
+
+    /// Returns true if write_bytes_async() returns before the data has been sent
+    virtual bool isAsync() { return false; }
 };
 
 
@@ -49,6 +104,10 @@ class VS1053_SPIESP32 : public VS1053_SPI {
         SPISettings settings(speed, MSBFIRST, SPI_MODE0);       
         p_spi->beginTransaction(settings);
     }
+    void beginTransaction(uint32_t value)  override {
+        SPISettings settings(value, MSBFIRST, SPI_MODE0);
+        p_spi->beginTransaction(settings);
+    }
     void endTransaction()  override{p_spi->endTransaction();}
     void set_speed(uint32_t value){ this->speed = value;}
 
@@ -71,6 +130,10 @@ class VS1053_SPIESP32 : public VS1053_SPI {
     uint16_t read16(uint16_t port) override {
         return p_spi->transfer16(port);
     }
+
+    void write_repeat(uint8_t value, uint32_t count) override {
+        if (count > 0) p_spi->writePattern(&value, 1, count);
+    }
   protected:
     SPIClass *p_spi;
 
@@ -103,6 +166,10 @@ class VS1053_SPIArduino : public VS1053_SPI {
         SPISettings settings(speed, MSBFIRST, SPI_MODE0);       
         p_spi->beginTransaction(settings);
     }
+    void beginTransaction(uint32_t value)  override {
+        SPISettings settings(value, MSBFIRST, SPI_MODE0);
+        p_spi->beginTransaction(settings);
+    }
     void endTransaction()  override {p_spi->endTransaction();}
     void set_speed(uint32_t value){ this->speed = value;}
 
@@ -0,0 +1,117 @@
+#pragma once
+#ifndef ARDUINO
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "VS1053SPI.h"
+
+namespace arduino_vs1053 {
+
+/**
+ * @brief Asynchronous SPI driver outside of Arduino: write_bytes_async() hands the data
+ * over to a separate thread which writes it with the wrapped driver (e.g. the
+ * VS1053Simulator). This way we can test the asynchronous (DMA) code path on a PC.
+ * All other operations wait for the completion of the pending write.
+ * @author pschatzmann
+ */
+class VS1053_SPIThreaded : public VS1053_SPI {
+  public:
+    VS1053_SPIThreaded(VS1053_SPI &spi) : spi(spi) { thread = std::thread(&VS1053_SPIThreaded::run, this); }
+
+    ~VS1053_SPIThreaded() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            is_active = false;
+        }
+        cv.notify_all();
+        thread.join();
+    }
+
+    void beginTransaction() override {
+        await_write();
+        spi.beginTransaction();
+    }
+    void beginTransaction(uint32_t speed) override {
+        await_write();
+        spi.beginTransaction(speed);
+    }
+    void endTransaction() override {
+        await_write();
+        spi.endTransaction();
+    }
+    void set_speed(uint32_t speed) override {
+        await_write();
+        spi.set_speed(speed);
+    }
+    void write(uint8_t data) override {
+        await_write();
+        spi.write(data);
+    }
+    void write16(uint16_t data) override {
+        await_write();
+        spi.write16(data);
+    }
+    void write_bytes(uint8_t *data, uint32_t size) override {
+        await_write();
+        spi.write_bytes(data, size);
+    }
+    uint8_t transfer(uint8_t data) override {
+        await_write();
+        return spi.transfer(data);
+    }
+    uint16_t read16(uint16_t port) override {
+        await_write();
+        return spi.read16(port);
+    }
+
+    void write_bytes_async(const uint8_t *data, uint32_t size) override {
+        await_write();
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            p_data = data;
+            data_size = size;
+            async_writes++;
+        }
+        cv.notify_all();
+    }
+
+    void await_write() override {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this] { return p_data == nullptr; });
+    }
+
+    bool isAsync() override { return true; }
+
+    /// Number of write_bytes_async() calls
+    uint64_t asyncWrites() { return async_writes; }
+
+  protected:
+    VS1053_SPI &spi;
+    std::thread thread;
+    std::mutex mtx;
+    std::condition_variable cv;
+    const uint8_t *p_data = nullptr;
+    uint32_t data_size = 0;
+    uint64_t async_writes = 0;
+    bool is_active = true;
+
+    /// Writes the submitted data in the background
+    void run() {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (true) {
+            cv.wait(lock, [this] { return !is_active || p_data != nullptr; });
+            if (!is_active) return;
+            const uint8_t *data = p_data;
+            uint32_t size = data_size;
+            lock.unlock();
+            spi.write_bytes(const_cast<uint8_t *>(data), size);
+            lock.lock();
+            p_data = nullptr;
+            cv.notify_all();
+        }
+    }
+};
+
+}
+
+#endif
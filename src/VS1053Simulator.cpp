@@ -0,0 +1,655 @@
+#ifndef ARDUINO
+#include "VS1053Simulator.h"
+#include <math.h>
+
+namespace arduino_vs1053 {
+
+VS1053Simulator::VS1053Simulator(uint8_t cs, uint8_t dcs, uint8_t dreq, int16_t reset, uint8_t ver)
+        : cs_pin(cs), dcs_pin(dcs), dreq_pin(dreq), reset_pin(reset), version(ver), wram(0x10000) {
+    memset(pins, HIGH, sizeof(pins));
+    hard_reset();
+    busy_until_ns = 0;
+}
+
+void VS1053Simulator::begin() {
+    setPinHooks(this);
+}
+
+void VS1053Simulator::end() {
+    setPinHooks(nullptr);
+}
+
+void VS1053Simulator::setBitrate(uint32_t bps) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    update();
+    bitrate_bps = bps;
+}
+
+void VS1053Simulator::setDecoderClock(uint32_t hz) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    update();
+    decoder_clki_hz = hz;
+}
+
+void VS1053Simulator::setYieldTime(uint32_t us) {
+    yield_ns = 1000ull * us;
+}
+
+void VS1053Simulator::setSciBusyTime(uint32_t us) {
+    sci_busy_ns = 1000ull * us;
+}
+
+void VS1053Simulator::setCancelBytes(uint32_t bytes) {
+    cancel_bytes = bytes;
+}
+
+void VS1053Simulator::setEndFillByte(uint8_t value) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    end_fill_byte = value;
+    wram[0x1E06] = value;
+}
+
+uint64_t VS1053Simulator::now() {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    return now_ns / 1000;
+}
+
+void VS1053Simulator::advance(uint64_t us) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    advance_ns(1000ull * us);
+}
+
+uint16_t VS1053Simulator::registerValue(uint8_t reg) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    update();
+    return regs[reg & 0xF];
+}
+
+uint16_t VS1053Simulator::wramValue(uint16_t address) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    return wram[address];
+}
+
+size_t VS1053Simulator::fifoAvailable() {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    update();
+    return fifo_count;
+}
+
+size_t VS1053Simulator::recordAvailable() {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    update();
+    return record_count;
+}
+
+bool VS1053Simulator::isRecording() {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    return recording;
+}
+
+bool VS1053Simulator::isDataRequest() {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    update();
+    return dreq();
+}
+
+VS1053SimulatorStats VS1053Simulator::stats() {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    return stat;
+}
+
+void VS1053Simulator::resetStats() {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    stat = VS1053SimulatorStats();
+}
+
+double VS1053Simulator::audioSeconds() {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    return bitrate_bps == 0 ? 0.0 : 8.0 * stat.decoded_bytes / bitrate_bps;
+}
+
+void VS1053Simulator::beginTransaction() {
+    bus.lock();
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    stat.spi_calls++;
+    stat.transactions++;
+}
+
+void VS1053Simulator::beginTransaction(uint32_t value) {
+    bus.lock();
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    stat.spi_calls++;
+    stat.transactions++;
+    speed = value;
+}
+
+void VS1053Simulator::endTransaction() {
+    {
+        std::lock_guard<std::recursive_mutex> lock(mtx);
+        stat.spi_calls++;
+    }
+    bus.unlock();
+}
+
+void VS1053Simulator::set_speed(uint32_t value) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    stat.spi_calls++;
+    speed = value;
+}
+
+void VS1053Simulator::write(uint8_t data) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    stat.spi_calls++;
+    transfer_byte(data);
+}
+
+void VS1053Simulator::write16(uint16_t data) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    stat.spi_calls++;
+    transfer_byte(data >> 8);
+    transfer_byte(data & 0xFF);
+}
+
+void VS1053Simulator::write_bytes(uint8_t *data, uint32_t size) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    stat.spi_calls++;
+    for (uint32_t j = 0; j < size; j++) {
+        transfer_byte(data[j]);
+    }
+}
+
+void VS1053Simulator::write_repeat(uint8_t value, uint32_t count) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    stat.spi_calls++;
+    for (uint32_t j = 0; j < count; j++) {
+        transfer_byte(value);
+    }
+}
+
+void VS1053Simulator::write_interleaved(uint8_t prefix, const uint8_t *data, uint32_t size) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    stat.spi_calls++;
+    for (uint32_t j = 0; j < size; j++) {
+        transfer_byte(prefix);
+        transfer_byte(data[j]);
+    }
+}
+
+void VS1053Simulator::write_gather(const VS1053_SPIBuffer *buffers, size_t count) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    stat.spi_calls++;
+    for (size_t j = 0; j < count; j++) {
+        for (uint32_t k = 0; k < buffers[j].size; k++) {
+            transfer_byte(buffers[j].data[k]);
+        }
+    }
+}
+
+uint8_t VS1053Simulator::transfer(uint8_t data) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    stat.spi_calls++;
+    return transfer_byte(data);
+}
+
+uint16_t VS1053Simulator::read16(uint16_t port) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    stat.spi_calls++;
+    uint16_t result = transfer_byte(port >> 8) << 8;
+    return result | transfer_byte(port & 0xFF);
+}
+
+void VS1053Simulator::delay(uint32_t ms) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    stat.delay_us += 1000ull * ms;
+    advance_ns(1000000ull * ms);
+}
+
+void VS1053Simulator::yield() {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    stat.yields++;
+    advance_ns(yield_ns);
+}
+
+void VS1053Simulator::digitalWrite(uint8_t pin, uint8_t value) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    stat.pin_writes++;
+    value = value ? HIGH : LOW;
+    if (pins[pin] == value) return;
+    stat.pin_toggles++;
+    pins[pin] = value;
+    update();
+    if (pin == cs_pin) {
+        // a falling edge starts a new SCI operation
+        sci_pos = value == LOW ? 0 : -1;
+    } else if (reset_pin >= 0 && pin == reset_pin) {
+        if (value == LOW) {
+            in_reset = true;
+        } else {
+            hard_reset();
+        }
+    }
+}
+
+int VS1053Simulator::digitalRead(uint8_t pin) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    stat.pin_reads++;
+    if (pin != dreq_pin) return pins[pin];
+    update();
+    bool result = dreq();
+    if (!result) stat.dreq_stalls++;
+    return result ? HIGH : LOW;
+}
+
+void VS1053Simulator::pinMode(uint8_t /*pin*/, uint8_t /*mode*/) {}
+
+unsigned long VS1053Simulator::millis() {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    return now_ns / 1000000;
+}
+
+unsigned long VS1053Simulator::micros() {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    return now_ns / 1000;
+}
+
+void VS1053Simulator::attachInterrupt(uint8_t pin, void (*isr)(void *), void *arg) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    if (pin != dreq_pin) return;
+    dreq_isr_arg = arg;
+    dreq_isr = isr;
+}
+
+void VS1053Simulator::detachInterrupt(uint8_t pin) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    if (pin == dreq_pin) dreq_isr = nullptr;
+}
+
+/// We sleep until DREQ rises (which triggers the interrupt) or until the timeout
+bool VS1053Simulator::waitForInterrupt(uint32_t timeout_us) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    update();
+    uint64_t limit = now_ns + 1000ull * timeout_us;
+    uint64_t edge = next_dreq_ns();
+    uint64_t target = edge < limit ? edge : limit;
+    stat.sleep_us += (target - now_ns) / 1000;
+    advance_ns(target - now_ns);
+    return edge <= limit;
+}
+
+double VS1053Simulator::cpuLoad(uint64_t virtual_us) {
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    if (virtual_us == 0) return 0.0;
+    return 100.0 * (virtual_us - stat.delay_us - stat.sleep_us) / virtual_us;
+}
+
+void VS1053Simulator::advance_ns(uint64_t ns) {
+    now_ns += ns;
+    update();
+    bool active = dreq();
+    if (active && !last_dreq && dreq_isr != nullptr) {
+        stat.interrupts++;
+        dreq_isr(dreq_isr_arg);
+    }
+    last_dreq = active;
+}
+
+/// Determines the time when DREQ will be high
+uint64_t VS1053Simulator::next_dreq_ns() {
+    if (dreq()) return now_ns;
+    if (in_reset) return UINT64_MAX;
+    uint64_t start = busy_until_ns > now_ns ? busy_until_ns : now_ns;
+    if (recording || fifo_size - fifo_count >= 32) return start;
+    if (bitrate_bps == 0) return UINT64_MAX;
+    double missing = (fifo_count - (fifo_size - 32)) - decode_credit;
+    return start + static_cast<uint64_t>(missing * 8e9 / bitrate_bps) + 1;
+}
+
+/// Lets the decoder consume the FIFO and the recorder produce data up to the actual time
+void VS1053Simulator::update() {
+    uint64_t elapsed = now_ns - last_update_ns;
+    last_update_ns = now_ns;
+    if (in_reset || now_ns < busy_until_ns || elapsed == 0) return;
+
+    if (recording) {
+        record_credit += static_cast<double>(elapsed) * record_words_per_second() / 1e9;
+        // the Ogg Vorbis encoder finishes the stream after a stop request in AICTRL3
+        if (ogg && (regs[AICTRL3] & 1) && ogg_flush_words < 0) ogg_flush_words = 64;
+        while (record_credit >= 1.0 && !(ogg && (regs[AICTRL3] & 2))) {
+            record_credit -= 1.0;
+            uint16_t word = next_record_word();
+            stat.recorded_words++;
+            if (record_count < record_buffer_size) {
+                record_buffer[(record_read + record_count) % record_buffer_size] = word;
+                record_count++;
+            } else {
+                stat.record_overflows++;
+            }
+        }
+        return;
+    }
+
+    if (fifo_count == 0) {
+        // an idle decoder can not save up time
+        decode_credit = 0;
+        return;
+    }
+    decode_credit += static_cast<double>(elapsed) * decoder_speed() / 8e9;
+    size_t n = decode_credit < fifo_count ? static_cast<size_t>(decode_credit) : fifo_count;
+    decode_credit -= n;
+    fifo_read = (fifo_read + n) % fifo_size;
+    fifo_count -= n;
+    stat.decoded_bytes += n;
+
+    if (regs[MODE] & SM_CANCEL) {
+        cancel_remaining = n >= cancel_remaining ? 0 : cancel_remaining - n;
+        if (cancel_remaining == 0) {
+            regs[MODE] &= ~SM_CANCEL;
+        }
+    }
+}
+
+bool VS1053Simulator::dreq() {
+    if (in_reset || now_ns < busy_until_ns) return false;
+    return recording || fifo_size - fifo_count >= 32;
+}
+
+uint8_t VS1053Simulator::transfer_byte(uint8_t data) {
+    stat.spi_bytes++;
+    advance_ns(8000000000ull / speed);
+    if (in_reset) return 0xFF;
+    if (pins[cs_pin] == LOW) return sci_byte(data);
+    if (pins[dcs_pin] == LOW) sdi_byte(data);
+    return 0xFF;
+}
+
+uint8_t VS1053Simulator::sci_byte(uint8_t data) {
+    uint8_t result = 0;
+    switch (sci_pos) {
+        case 0:
+            if (now_ns < busy_until_ns) stat.sci_busy_access++;
+            sci_op = data;
+            sci_pos = 1;
+            break;
+        case 1:
+            sci_addr = data & 0xF;
+            sci_pos = 2;
+            if (sci_op == 3) {
+                stat.sci_reads++;
+                sci_value = sci_read(sci_addr);
+                // the data is sampled too late: the bits are shifted
+                if (speed > clki_hz() / 7) {
+                    stat.speed_errors++;
+                    sci_value = (sci_value << 1) | 1;
+                }
+            }
+            break;
+        case 2:
+            if (sci_op == 3) {
+                result = sci_value >> 8;
+            } else {
+                sci_hi = data;
+            }
+            sci_pos = 3;
+            break;
+        case 3:
+            if (sci_op == 3) {
+                result = sci_value & 0xFF;
+                sci_pos = 4;
+            } else if (sci_op == 2) {
+                stat.sci_writes++;
+                uint16_t value = (sci_hi << 8) | data;
+                if (speed > clki_hz() / 4) {
+                    stat.speed_errors++;
+                    value = (value << 1) | 1;
+                }
+                sci_write(sci_addr, value);
+                // SCI multiple write: further words go to the same register
+                sci_pos = 2;
+            }
+            break;
+        default:
+            result = 0xFF;
+            break;
+    }
+    return result;
+}
+
+void VS1053Simulator::sdi_byte(uint8_t data) {
+    stat.sdi_bytes++;
+    if (speed > clki_hz() / 4) {
+        stat.speed_errors++;
+        data = (data << 1) | 1;
+    }
+    if (fifo_count >= fifo_size) {
+        stat.fifo_overflows++;
+        return;
+    }
+    fifo[(fifo_read + fifo_count) % fifo_size] = data;
+    fifo_count++;
+}
+
+uint16_t VS1053Simulator::sci_read(uint8_t reg) {
+    switch (reg) {
+        case WRAM:
+            return wram[regs[WRAMADDR]++];
+        case HDAT0:
+            if (recording) {
+                if (record_count == 0) return 0;
+                uint16_t result = record_buffer[record_read];
+                record_read = (record_read + 1) % record_buffer_size;
+                record_count--;
+                return result;
+            }
+            return regs[HDAT0];
+        case HDAT1:
+            return recording ? record_count : regs[HDAT1];
+        default:
+            return regs[reg];
+    }
+}
+
+void VS1053Simulator::sci_write(uint8_t reg, uint16_t value) {
+    busy_until_ns = now_ns + sci_busy_ns;
+    switch (reg) {
+        case MODE:
+            regs[MODE] = value & ~SM_RESET;
+            if (value & SM_CANCEL) {
+                cancel_remaining = cancel_bytes;
+            }
+            if (value & SM_RESET) {
+                soft_reset();
+            } else if (!(value & SM_ADPCM)) {
+                recording = false;
+            }
+            break;
+        case STATUS:
+            regs[STATUS] = (value & 0xFF0F) | (version << 4);
+            break;
+        case WRAM:
+            wram[regs[WRAMADDR]++] = value;
+            break;
+        case AIADDR:
+            regs[AIADDR] = value;
+            // starting a user application in ADPCM mode activates the recording plugin
+            if (value != 0 && (regs[MODE] & SM_ADPCM)) {
+                recording = true;
+            }
+            // 0x34 starts the Ogg Vorbis encoder which reads its profile from WRAMADDR
+            ogg = version == 4 && value == 0x34;
+            if (ogg) ogg_kbps = (regs[WRAMADDR] & 0xC000) ? regs[WRAMADDR] & 0xFFF : 16 + 8 * (regs[WRAMADDR] & 0xF);
+            break;
+        default:
+            regs[reg] = value;
+            break;
+    }
+}
+
+void VS1053Simulator::hard_reset() {
+    memset(regs, 0, sizeof(regs));
+    regs[MODE] = 0x4800;
+    regs[STATUS] = version << 4;
+    std::fill(wram.begin(), wram.end(), 0);
+    wram[0x1E06] = end_fill_byte;
+    in_reset = false;
+    soft_reset();
+}
+
+void VS1053Simulator::soft_reset() {
+    fifo_read = fifo_count = 0;
+    record_read = record_count = 0;
+    decode_credit = record_credit = 0;
+    regs[DECODE_TIME] = regs[HDAT0] = regs[HDAT1] = regs[AIADDR] = 0;
+    // ADPCM + reset activates the recording of the VS1053
+    recording = (regs[MODE] & SM_ADPCM) && version == 4;
+    busy_until_ns = now_ns + reset_ns;
+    adpcm_pos = adpcm_words = 0;
+    adpcm_predictor[0] = adpcm_predictor[1] = 0;
+    adpcm_index[0] = adpcm_index[1] = 0;
+    adpcm_sample = 0;
+    ogg = false;
+    ogg_bytes = 0;
+    ogg_flush_words = -1;
+}
+
+/// Clock multiplier from SC_MULT of SCI_CLOCKF in units of 0.5 x XTALI
+uint32_t VS1053Simulator::clock_multiplier() {
+    static const uint8_t multipliers_53[8] = {2, 4, 5, 6, 7, 8, 9, 10};
+    static const uint8_t multipliers_03[8] = {2, 3, 4, 5, 6, 7, 8, 9};
+    return (version == 4 ? multipliers_53 : multipliers_03)[regs[CLOCKF] >> 13];
+}
+
+/// Crystal frequency from SC_FREQ of SCI_CLOCKF
+uint32_t VS1053Simulator::xtali_hz() {
+    uint16_t freq = regs[CLOCKF] & 0x7FF;
+    return freq == 0 ? 12288000 : 8000000 + freq * 4000;
+}
+
+/// Internal clock from SC_MULT and SC_FREQ of SCI_CLOCKF
+uint32_t VS1053Simulator::clki_hz() {
+    return xtali_hz() / 2 * clock_multiplier();
+}
+
+/// Bitrate which can be decoded with the actual clock
+uint32_t VS1053Simulator::decoder_speed() {
+    if (decoder_clki_hz == 0) return bitrate_bps;
+    // SC_ADD: the decoder can raise the clock by 1.0, 1.5 or 2.0 x XTALI up to 5.0 x
+    static const uint8_t additions[4] = {0, 2, 3, 4};
+    uint32_t multiplier = clock_multiplier() + additions[(regs[CLOCKF] >> 11) & 3];
+    if (multiplier > 10) multiplier = 10;
+    uint64_t clock = static_cast<uint64_t>(xtali_hz()) / 2 * multiplier;
+    if (clock >= decoder_clki_hz) return bitrate_bps;
+    return clock * bitrate_bps / decoder_clki_hz;
+}
+
+uint32_t VS1053Simulator::record_words_per_second() {
+    if (ogg) return ogg_kbps * 1000 / 16;
+    uint32_t rate;
+    uint8_t channels = 1;
+    if (version == 4) {
+        rate = regs[AICTRL0] == 0 ? 8000 : regs[AICTRL0];
+        // AICTRL3 0: joint stereo, 1: dual channel, 2: left, 3: right
+        if ((regs[AICTRL3] & 3) < 2) channels = 2;
+    } else {
+        // VS1003: the sample rate is derived from the clock multiplier and divider
+        static const float multipliers[8] = {1.0, 2.0, 2.5, 3.0, 3.5, 4.0, 4.5, 5.0};
+        uint16_t divider = regs[AICTRL0] == 0 ? 12 : regs[AICTRL0];
+        rate = multipliers[regs[CLOCKF] >> 13] * 12288000 / 256 / divider;
+    }
+    if (is_adpcm()) return static_cast<uint64_t>(rate) * channels * (VS1053ADPCM::block_size / 2) /
+                           VS1053ADPCM::samples_per_block;
+    return rate * channels;
+}
+
+/// The VS1053 records IMA ADPCM if the linear PCM bit in AICTRL3 is not set
+bool VS1053Simulator::is_adpcm() {
+    return version == 4 && !ogg && (regs[AICTRL3] & 4) == 0;
+}
+
+/// PCM provides a counter, ADPCM the words of the encoded blocks and Ogg a byte pattern (big endian)
+uint16_t VS1053Simulator::next_record_word() {
+    if (ogg) {
+        uint16_t word = ogg_byte(ogg_bytes) << 8;
+        if (ogg_flush_words > 0 && --ogg_flush_words == 0) {
+            // the stream ends with an odd number of bytes: only the high byte is valid
+            regs[AICTRL3] |= 2 | 4;
+            ogg_bytes += 1;
+            return word;
+        }
+        word |= ogg_byte(ogg_bytes + 1);
+        ogg_bytes += 2;
+        return word;
+    }
+    if (!is_adpcm()) return stat.recorded_words;
+    if (adpcm_pos >= adpcm_words) encode_adpcm_block();
+    return adpcm_block[adpcm_pos++];
+}
+
+/// Encodes the next 505 samples per channel of a 1 kHz sine in the WAV IMA ADPCM block layout
+void VS1053Simulator::encode_adpcm_block() {
+    int channels = (regs[AICTRL3] & 3) < 2 ? 2 : 1;
+    uint32_t rate = regs[AICTRL0] == 0 ? 8000 : regs[AICTRL0];
+    int16_t samples[VS1053ADPCM::samples_per_block];
+    uint8_t bytes[VS1053ADPCM::block_size * 2];
+    for (int j = 0; j < VS1053ADPCM::samples_per_block; j++) {
+        samples[j] = static_cast<int16_t>(8000.0 * sin(2.0 * M_PI * 1000.0 * (adpcm_sample + j) / rate));
+    }
+    adpcm_sample += VS1053ADPCM::samples_per_block;
+    uint8_t *p = bytes;
+    for (int ch = 0; ch < channels; ch++) {
+        // the first sample is stored in the header
+        adpcm_predictor[ch] = samples[0];
+        *p++ = samples[0] & 0xFF;
+        *p++ = (samples[0] >> 8) & 0xFF;
+        *p++ = adpcm_index[ch];
+        *p++ = 0;
+    }
+    for (int group = 0; group < (VS1053ADPCM::samples_per_block - 1) / 8; group++) {
+        for (int ch = 0; ch < channels; ch++) {
+            for (int j = 0; j < 8; j += 2) {
+                int pos = 1 + group * 8 + j;
+                uint8_t lo = encode_adpcm_sample(samples[pos], ch);
+                uint8_t hi = encode_adpcm_sample(samples[pos + 1], ch);
+                *p++ = lo | (hi << 4);
+            }
+        }
+    }
+    adpcm_words = (p - bytes) / 2;
+    for (size_t j = 0; j < adpcm_words; j++) {
+        adpcm_block[j] = (bytes[j * 2] << 8) | bytes[j * 2 + 1];
+    }
+    adpcm_pos = 0;
+}
+
+/// Test pattern of the encoder output: pages of 64 bytes which start with "OggS"
+uint8_t VS1053Simulator::ogg_byte(uint32_t pos) {
+    static const char capture[] = "OggS";
+    uint32_t offset = pos % 64;
+    if (offset < 4) return capture[offset];
+    return (pos / 64 + offset) & 0xFF;
+}
+
+uint8_t VS1053Simulator::encode_adpcm_sample(int16_t sample, int ch) {
+    int step = VS1053ADPCM::step_table[adpcm_index[ch]];
+    int diff = sample - adpcm_predictor[ch];
+    uint8_t nibble = 0;
+    if (diff < 0) {
+        nibble = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        nibble |= 4;
+        diff -= step;
+    }
+    if (diff >= step >> 1) {
+        nibble |= 2;
+        diff -= step >> 1;
+    }
+    if (diff >= step >> 2) nibble |= 1;
+    // the encoder needs to track the decoder
+    VS1053ADPCM::decodeSample(nibble, adpcm_predictor[ch], adpcm_index[ch]);
+    return nibble;
+}
+
+}
+
+#endif
@@ -0,0 +1,232 @@
+#pragma once
+#ifndef ARDUINO
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#include "VS1053SPI.h"
+#include "VS1053ADPCM.h"
+
+namespace arduino_vs1053 {
+
+/**
+ * @brief Counters which are collected by the VS1053Simulator
+ */
+struct VS1053SimulatorStats {
+    uint64_t spi_calls = 0;         // virtual VS1053_SPI calls
+    uint64_t spi_bytes = 0;         // bytes clocked over the bus
+    uint64_t transactions = 0;      // beginTransaction() calls
+    uint64_t sci_reads = 0;         // SCI read operations
+    uint64_t sci_writes = 0;        // SCI words written
+    uint64_t sdi_bytes = 0;         // bytes received via SDI
+    uint64_t pin_writes = 0;        // digitalWrite() calls
+    uint64_t pin_toggles = 0;       // digitalWrite() calls which changed the pin
+    uint64_t pin_reads = 0;         // digitalRead() calls
+    uint64_t dreq_stalls = 0;       // DREQ reads which reported LOW
+    uint64_t yields = 0;            // yield() calls
+    uint64_t delay_us = 0;          // virtual time spent in delay()
+    uint64_t sleep_us = 0;          // virtual time spent in waitForInterrupt()
+    uint64_t interrupts = 0;        // DREQ rising edge interrupts
+    uint64_t fifo_overflows = 0;    // SDI bytes which were lost
+    uint64_t decoded_bytes = 0;     // SDI bytes consumed by the decoder
+    uint64_t recorded_words = 0;    // words produced by the recorder
+    uint64_t record_overflows = 0;  // recorded words which were lost
+    uint64_t sci_busy_access = 0;   // SCI operations started before the previous write was completed
+    uint64_t speed_errors = 0;      // words or bytes which were corrupted because the SPI clock exceeded the legal max
+};
+
+/**
+ * @brief Simulated VS1053 / VS1003 chip which can be used to run the driver
+ * outside of Arduino. It implements the SPI interface and the pin hooks and
+ * provides a SCI register file, WRAM, a 2 KB SDI FIFO which drains at the
+ * configured bitrate, DREQ, SM_RESET / SM_CANCEL handling and the
+ * HDAT0/HDAT1 recording output (PCM, IMA ADPCM blocks of a 1 kHz sine or Ogg pages with
+ * a test pattern when the encoder application is started). SPI clocks above CLKI/7 for SCI
+ * reads or CLKI/4 for writes corrupt the transferred data and the decoder slows down if the
+ * clock is below the configured decoder clock. All timing is based on a virtual clock
+ * which is advanced by the SPI transfers, delay() and yield().
+ * @author pschatzmann
+ */
+class VS1053Simulator : public VS1053_SPI, public VS1053PinHooks {
+  public:
+    static const size_t fifo_size = 2048;
+    static const size_t record_buffer_size = 1024;
+
+    /// Constructor: the version is 4 for a VS1053 and 3 for a VS1003
+    VS1053Simulator(uint8_t cs_pin, uint8_t dcs_pin, uint8_t dreq_pin, int16_t reset_pin = -1, uint8_t version = 4);
+
+    /// Registers the simulator as pin hooks
+    void begin();
+
+    /// Restores the default pin hooks
+    void end();
+
+    /// Defines the bitrate in bits per second with which the decoder consumes the SDI data
+    void setBitrate(uint32_t bps);
+
+    /// Clock (CLKI incl. SC_ADD) in Hz which the decoder needs to process the bitrate in real time: 0 = any clock
+    void setDecoderClock(uint32_t hz);
+
+    /// Virtual time in us which passes on each yield() call
+    void setYieldTime(uint32_t us);
+
+    /// Virtual time in us in which DREQ stays low after a SCI write
+    void setSciBusyTime(uint32_t us);
+
+    /// Number of bytes the decoder processes before it acknowledges SM_CANCEL
+    void setCancelBytes(uint32_t bytes);
+
+    /// Value which is reported as endFillByte
+    void setEndFillByte(uint8_t value);
+
+    /// Virtual time in us
+    uint64_t now();
+
+    /// Advances the virtual clock by the indicated us
+    void advance(uint64_t us);
+
+    /// Provides the actual value of a SCI register
+    uint16_t registerValue(uint8_t reg);
+
+    /// Provides the actual value of a WRAM address
+    uint16_t wramValue(uint16_t address);
+
+    /// Number of bytes in the SDI FIFO
+    size_t fifoAvailable();
+
+    /// Number of recorded words which can be read via SCI_HDAT0
+    size_t recordAvailable();
+
+    /// Checks if the recording is active
+    bool isRecording();
+
+    /// Provides the actual DREQ state
+    bool isDataRequest();
+
+    /// Provides a copy of the collected counters
+    VS1053SimulatorStats stats();
+
+    /// Resets all counters
+    void resetStats();
+
+    /// Seconds of audio which have been decoded
+    double audioSeconds();
+
+    // VS1053_SPI
+    void beginTransaction() override;
+    void beginTransaction(uint32_t speed) override;
+    void endTransaction() override;
+    void set_speed(uint32_t speed) override;
+    void write(uint8_t data) override;
+    void write16(uint16_t data) override;
+    void write_bytes(uint8_t *data, uint32_t size) override;
+    uint8_t transfer(uint8_t data) override;
+    uint16_t read16(uint16_t port) override;
+    void write_repeat(uint8_t value, uint32_t count) override;
+    void write_interleaved(uint8_t prefix, const uint8_t *data, uint32_t size) override;
+    void write_gather(const VS1053_SPIBuffer *buffers, size_t count) override;
+
+    // VS1053PinHooks
+    void delay(uint32_t ms) override;
+    void yield() override;
+    void digitalWrite(uint8_t pin, uint8_t value) override;
+    int digitalRead(uint8_t pin) override;
+    void pinMode(uint8_t pin, uint8_t mode) override;
+    unsigned long millis() override;
+    unsigned long micros() override;
+    void attachInterrupt(uint8_t pin, void (*isr)(void *), void *arg) override;
+    void detachInterrupt(uint8_t pin) override;
+    bool waitForInterrupt(uint32_t timeout_us) override;
+
+    /// Percentage of the virtual time which was not spent in delay() or waitForInterrupt()
+    double cpuLoad(uint64_t virtual_us);
+
+  protected:
+    // SCI register numbers and SCI_MODE bits
+    enum { MODE = 0x0, STATUS = 0x1, CLOCKF = 0x3, DECODE_TIME = 0x4, AUDATA = 0x5, WRAM = 0x6,
+           WRAMADDR = 0x7, HDAT0 = 0x8, HDAT1 = 0x9, AIADDR = 0xA, AICTRL0 = 0xC, AICTRL3 = 0xF };
+    enum { SM_RESET = 1 << 2, SM_CANCEL = 1 << 3, SM_ADPCM = 1 << 12 };
+
+    std::recursive_mutex mtx;
+    std::recursive_mutex bus;
+    VS1053SimulatorStats stat;
+    uint8_t cs_pin, dcs_pin, dreq_pin;
+    int16_t reset_pin;
+    uint8_t version;
+    uint8_t pins[256];
+    void (*dreq_isr)(void *) = nullptr;
+    void *dreq_isr_arg = nullptr;
+    bool last_dreq = false;
+
+    // configuration
+    uint32_t bitrate_bps = 128000;
+    uint32_t decoder_clki_hz = 0;
+    uint64_t yield_ns = 5000;
+    uint64_t sci_busy_ns = 5000;
+    uint64_t reset_ns = 1800000;
+    uint32_t cancel_bytes = 64;
+    uint8_t end_fill_byte = 0;
+    uint32_t speed = 200000;
+
+    // chip state
+    uint64_t now_ns = 0;
+    uint64_t last_update_ns = 0;
+    uint64_t busy_until_ns = 0;
+    bool in_reset = false;
+    uint16_t regs[16];
+    std::vector<uint16_t> wram;
+    uint8_t fifo[fifo_size];
+    size_t fifo_read = 0;
+    size_t fifo_count = 0;
+    double decode_credit = 0;
+    uint32_t cancel_remaining = 0;
+    bool recording = false;
+    uint16_t record_buffer[record_buffer_size];
+    size_t record_read = 0;
+    size_t record_count = 0;
+    double record_credit = 0;
+    // IMA ADPCM encoder state
+    uint16_t adpcm_block[VS1053ADPCM::block_size];
+    size_t adpcm_pos = 0;
+    size_t adpcm_words = 0;
+    int32_t adpcm_predictor[2] = {0, 0};
+    int adpcm_index[2] = {0, 0};
+    uint32_t adpcm_sample = 0;
+    // Ogg Vorbis encoder state
+    bool ogg = false;
+    uint32_t ogg_bytes = 0;
+    uint32_t ogg_kbps = 0;
+    int32_t ogg_flush_words = -1;
+
+    // SCI protocol state
+    int sci_pos = -1;
+    uint8_t sci_op = 0;
+    uint8_t sci_addr = 0;
+    uint8_t sci_hi = 0;
+    uint16_t sci_value = 0;
+
+    void update();
+    void advance_ns(uint64_t ns);
+    uint8_t transfer_byte(uint8_t data);
+    uint8_t sci_byte(uint8_t data);
+    void sdi_byte(uint8_t data);
+    uint16_t sci_read(uint8_t reg);
+    void sci_write(uint8_t reg, uint16_t value);
+    void hard_reset();
+    void soft_reset();
+    uint32_t record_words_per_second();
+    uint32_t clock_multiplier();
+    uint32_t xtali_hz();
+    uint32_t clki_hz();
+    uint32_t decoder_speed();
+    bool is_adpcm();
+    uint8_t ogg_byte(uint32_t pos);
+    uint16_t next_record_word();
+    void encode_adpcm_block();
+    uint8_t encode_adpcm_sample(int16_t sample, int ch);
+    bool dreq();
+    uint64_t next_dreq_ns();
+};
+
+}
+
+#endif
@@ -0,0 +1,138 @@
+#pragma once
+#include "VS1053Driver.h"
+
+namespace arduino_vs1053 {
+
+/**
+ * @brief Pin access with the Arduino API: the pin numbers are template parameters, so
+ * that alternative implementations can use them as compile time constants.
+ * @author pschatzmann
+ */
+struct VS1053Gpio {
+    template <uint8_t pin>
+    static inline void setup() {}
+
+    template <uint8_t pin>
+    static inline void write(uint8_t value) {
+        digitalWrite(pin, value);
+    }
+
+    template <uint8_t pin>
+    static inline bool read() {
+        return digitalRead(pin);
+    }
+};
+
+#if defined(__AVR__)
+
+/**
+ * @brief Direct port access on AVR: the port registers and the bit mask are determined
+ * once, so a pin change is just a read-modify-write of the port register.
+ * @author pschatzmann
+ */
+struct VS1053GpioAVR {
+    template <uint8_t pin>
+    struct Port {
+        static volatile uint8_t *out;
+        static volatile uint8_t *in;
+        static uint8_t mask;
+    };
+
+    template <uint8_t pin>
+    static inline void setup() {
+        Port<pin>::out = portOutputRegister(digitalPinToPort(pin));
+        Port<pin>::in = portInputRegister(digitalPinToPort(pin));
+        Port<pin>::mask = digitalPinToBitMask(pin);
+    }
+
+    template <uint8_t pin>
+    static inline void write(uint8_t value) {
+        uint8_t sreg = SREG;
+        cli();
+        if (value) {
+            *Port<pin>::out |= Port<pin>::mask;
+        } else {
+            *Port<pin>::out &= ~Port<pin>::mask;
+        }
+        SREG = sreg;
+    }
+
+    template <uint8_t pin>
+    static inline bool read() {
+        return *Port<pin>::in & Port<pin>::mask;
+    }
+};
+
+template <uint8_t pin>
+volatile uint8_t *VS1053GpioAVR::Port<pin>::out = nullptr;
+template <uint8_t pin>
+volatile uint8_t *VS1053GpioAVR::Port<pin>::in = nullptr;
+template <uint8_t pin>
+uint8_t VS1053GpioAVR::Port<pin>::mask = 0;
+
+#endif
+
+/**
+ * @brief VS1053 with the SPI driver type and the pins as template parameters. The
+ * audio data path calls the SPI driver without virtual dispatch and uses the GPIO
+ * policy (e.g. VS1053GpioAVR) with constant pins. It is selected with one virtual call
+ * per writeAudio(), so it is also used via a VS1053& (e.g. by the VS1053Feeder). All
+ * other functionality is provided by the runtime configurable VS1053: special modes
+ * (MIDI, burst, other DREQ wait strategies) fall back to the regular implementation.
+ * @tparam SPI_T class of the SPI driver (e.g. VS1053_SPIArduino)
+ * @tparam GPIO pin access (default: Arduino API)
+ * @author pschatzmann
+ */
+template <class SPI_T, uint8_t CS, uint8_t DCS, uint8_t DREQ, class GPIO = VS1053Gpio>
+class VS1053Static : public VS1053 {
+  public:
+    /// Constructor: resetPin -1 means that there is no reset pin
+    VS1053Static(SPI_T &spi, int16_t resetPin = -1) : VS1053(CS, DCS, DREQ, 0, &spi), spi(spi) {
+        // the base constructor takes an uint8_t, which would turn -1 into pin 255
+        reset_pin = resetPin;
+        GPIO::template setup<CS>();
+        GPIO::template setup<DCS>();
+        GPIO::template setup<DREQ>();
+    }
+
+  protected:
+    SPI_T &spi;
+
+    /// Sends the audio data of writeAudio() and playChunk() in 32 byte steps (blocking)
+    void sdi_write_audio(uint8_t *data, size_t len) override {
+        if (!is_static_path()) {
+            VS1053::sdi_write_audio(data, len);
+            return;
+        }
+        spi.SPI_T::beginTransaction(active_speed.sdi);
+        await_sci_completion();
+        GPIO::template write<DCS>(LOW);
+        while (len > 0) {
+            if (!GPIO::template read<DREQ>()) await_dreq();
+            size_t n = len < vs1053_chunk_size ? len : vs1053_chunk_size;
+            spi.SPI_T::write_bytes(data, n);
+            data += n;
+            len -= n;
+        }
+        GPIO::template write<DCS>(HIGH);
+        spi.SPI_T::endTransaction();
+    }
+
+    /// Regular decoding with the default DREQ wait strategy: writeAudio() has already loaded the pending patch and clock
+    bool is_static_path() {
+        return mode == VS1053_OUT && !is_burst_mode && p_dreq_wait == &dreq_wait_busy;
+    }
+
+    void await_dreq() {
+        uint32_t start = dreq_timeout_ms > 0 ? millis() : 0;
+        while (!GPIO::template read<DREQ>()) {
+            if (dreq_timeout_ms > 0 && millis() - start >= dreq_timeout_ms) {
+                VS1053_LOGW("DREQ timeout");
+                return;
+            }
+            yield();
+        }
+    }
+};
+
+}
@@ -0,0 +1,41 @@
+/**
+ * Test for the lazy patch selection: startSong() must select the patch again
+ * from the first bytes of the next song.
+ */
+#include "VS1053Driver.h"
+#include "VS1053Simulator.h"
+
+using namespace arduino_vs1053;
+
+const uint8_t CS = 5;
+const uint8_t DCS = 16;
+const uint8_t DREQ = 4;
+
+int main() {
+#if USE_PATCHES_EXTENDED
+    VS1053Simulator sim(CS, DCS, DREQ);
+    sim.begin();
+    VS1053 player(CS, DCS, DREQ, -1, &sim);
+    player.setLazyPatches(true);
+    player.beginOutput();
+
+    uint8_t mp3[64] = {0xFF, 0xFB, 0x90, 0x64};
+    player.writeAudio(mp3, sizeof(mp3));
+    const VS1053Patch *patch = player.loadedPatch();
+    if (patch == nullptr || (patch->capabilities & VS1053_PATCH_FLAC) != 0) {
+        printf("MP3: unexpected patch %s\n", patch == nullptr ? "-" : patch->name);
+        return 1;
+    }
+
+    player.startSong();
+    uint8_t flac[64] = {'f', 'L', 'a', 'C'};
+    player.writeAudio(flac, sizeof(flac));
+    patch = player.loadedPatch();
+    if (patch == nullptr || (patch->capabilities & VS1053_PATCH_FLAC) == 0) {
+        printf("FLAC: patch was not uploaded\n");
+        return 1;
+    }
+    printf("ok: %s\n", patch->name);
+#endif
+    return 0;
+}